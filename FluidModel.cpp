@@ -0,0 +1,141 @@
+#include "FluidModel.h"
+
+#include <cmath>
+#include <stdexcept>
+
+FluidModel::FluidModel(const Scenario& scenario) : scenario(scenario) {
+    size_t n = scenario.vehicleTypes.size();
+    step = scenario.duration > 0 ? scenario.duration : INFINITY;
+    for (size_t i = 0; i < n; ++i) {
+        const VehicleType& t = scenario.vehicleTypes[i];
+        fleet.push_back(scenario.fleetMix.empty() ? double(scenario.numVehicles) / n : scenario.fleetMix[i]);
+        flightTime.push_back(t.batteryCapacity / (t.cruiseSpeed * t.energyPerMile));
+        chargeTime.push_back(t.timeToCharge);
+        // Also rejects NaN, which fails every comparison.
+        if (!(flightTime.back() > 0 && flightTime.back() < INFINITY && chargeTime.back() > 0 &&
+              chargeTime.back() < INFINITY))
+            throw std::runtime_error("the fluid model needs positive, finite flight and charge times");
+        step = std::min({step, flightTime.back() / 20, chargeTime.back() / 20});
+    }
+}
+
+FleetState FluidModel::initialState() const {
+    size_t n = fleet.size();
+    return {fleet, std::vector<double>(n), std::vector<double>(n)};
+}
+
+// Exponential Euler: over a step each phase drains by 1 - exp(-h / duration),
+// which never overshoots; admission to free chargers is then applied as a
+// projection so charging never exceeds the charger count.
+FleetState FluidModel::advance(const FleetState& state, double dt, std::vector<FluidStats>* totals) const {
+    FleetState x = state;
+    size_t n = fleet.size();
+    if (totals) totals->resize(n);
+    int steps = std::max(1, int(std::ceil(dt / step)));
+    double h = dt / steps;
+    std::vector<double> landFrac(n), chargeFrac(n);
+    for (size_t i = 0; i < n; ++i) {
+        landFrac[i] = 1 - std::exp(-h / flightTime[i]);
+        chargeFrac[i] = 1 - std::exp(-h / chargeTime[i]);
+    }
+
+    for (int s = 0; s < steps; ++s) {
+        double charging = 0, queued = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double landed = x.flying[i] * landFrac[i];
+            double charged = x.charging[i] * chargeFrac[i];
+            x.flying[i] += charged - landed;
+            x.charging[i] -= charged;
+            x.queued[i] += landed;
+            charging += x.charging[i];
+            queued += x.queued[i];
+
+            if (totals) {
+                const VehicleType& t = scenario.vehicleTypes[i];
+                double distance = t.cruiseSpeed * flightTime[i];
+                FluidStats& f = (*totals)[i];
+                f.totalFlights += landed;
+                f.totalFlightTime += landed * flightTime[i];
+                f.totalDistance += landed * distance;
+                f.passengerMiles += landed * t.passengerCount * distance;
+                f.totalFaults += landed * std::min(t.faultProbPerHour * flightTime[i], 1.0);
+                f.totalCharges += charged;
+                f.totalChargeTime += charged * chargeTime[i];
+            }
+        }
+
+        double admit = std::min(std::max(scenario.numChargers - charging, 0.0), queued);
+        if (admit > 0) {
+            for (size_t i = 0; i < n; ++i) {
+                double moved = admit * x.queued[i] / queued;
+                x.queued[i] -= moved;
+                x.charging[i] += moved;
+            }
+        }
+    }
+    return x;
+}
+
+std::map<Company, Stats> FluidModel::run(double horizon) const {
+    std::vector<FluidStats> totals;
+    advance(initialState(), horizon, &totals);
+
+    std::map<Company, FluidStats> byCompany;
+    for (size_t i = 0; i < totals.size(); ++i) {
+        FluidStats& f = byCompany[scenario.vehicleTypes[i].company];
+        f.totalFlightTime += totals[i].totalFlightTime;
+        f.totalDistance += totals[i].totalDistance;
+        f.totalChargeTime += totals[i].totalChargeTime;
+        f.passengerMiles += totals[i].passengerMiles;
+        f.totalFlights += totals[i].totalFlights;
+        f.totalCharges += totals[i].totalCharges;
+        f.totalFaults += totals[i].totalFaults;
+    }
+
+    std::map<Company, Stats> stats;
+    for (const auto& [comp, f] : byCompany) {
+        Stats& s = stats[comp];
+        s.totalFlightTime = f.totalFlightTime;
+        s.totalDistance = f.totalDistance;
+        s.totalChargeTime = f.totalChargeTime;
+        s.passengerMiles = f.passengerMiles;
+        s.totalFlights = std::llround(f.totalFlights);
+        s.totalCharges = std::llround(f.totalCharges);
+        s.totalFaults = std::llround(f.totalFaults);
+        s.expectedFaults = f.totalFaults;
+    }
+    return stats;
+}
+
+void FluidModel::printStats(double horizon) const {
+    std::vector<int> counts = roundedFleet();
+    std::map<Company, int> vehicleCount;
+    for (size_t i = 0; i < counts.size(); ++i)
+        vehicleCount[scenario.vehicleTypes[i].company] += counts[i];
+    ::printStats(run(horizon), vehicleCount);
+}
+
+// Expected counts (numVehicles spread evenly over the types) rounded to
+// whole vehicles with the total preserved.
+std::vector<int> FluidModel::roundedFleet() const {
+    if (!scenario.fleetMix.empty()) return scenario.fleetMix;
+    std::vector<int> counts(fleet.size());
+    int assigned = 0;
+    for (size_t i = 0; i < fleet.size(); ++i) {
+        counts[i] = int(fleet[i]);
+        assigned += counts[i];
+    }
+    for (size_t i = 0; assigned < scenario.numVehicles; ++i, ++assigned)
+        counts[i % counts.size()]++;
+    return counts;
+}
+
+// A detailed simulation positioned at startTime in the fluid trajectory,
+// e.g. to study the transient after a strategic change in full detail.
+Simulation FluidModel::seedSimulation(double startTime) const {
+    Scenario detailed = scenario;
+    detailed.fleetMix = roundedFleet();
+    Simulation sim(detailed);
+    if (startTime > 0) sim.liftFleetState(advance(initialState(), startTime), startTime);
+    return sim;
+}
@@ -0,0 +1,42 @@
+#ifndef FLUID_MODEL_H
+#define FLUID_MODEL_H
+
+#include "eVTOLSimulation.h"
+
+// Fractional counterparts of the Stats fields, per vehicle type.
+struct FluidStats {
+    double totalFlightTime = 0;
+    double totalDistance = 0;
+    double totalChargeTime = 0;
+    double passengerMiles = 0;
+    double totalFlights = 0;
+    double totalCharges = 0;
+    double totalFaults = 0;
+};
+
+// Fluid approximation of the fleet: per type, the vehicles flying, queued
+// and charging are continuous quantities. Flights and charges complete at
+// rate count / duration; free chargers take queued vehicles immediately,
+// shared between types in proportion to their queue. Cost depends only on
+// the horizon and the number of types, never on the fleet size, so it
+// answers aggregate questions for fleets of millions and can seed the
+// detailed simulator at any point in time. Every type must have positive,
+// finite flight and charge times.
+class FluidModel {
+public:
+    explicit FluidModel(const Scenario& scenario);
+    FleetState initialState() const;
+    FleetState advance(const FleetState& state, double dt, std::vector<FluidStats>* totals = nullptr) const;
+    std::map<Company, Stats> run(double horizon) const;
+    void printStats(double horizon) const;
+    Simulation seedSimulation(double startTime) const;
+    std::vector<int> roundedFleet() const;
+
+private:
+    Scenario scenario;
+    std::vector<double> fleet;
+    std::vector<double> flightTime, chargeTime;
+    double step;
+};
+
+#endif
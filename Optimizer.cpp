@@ -0,0 +1,317 @@
+#include "Optimizer.h"
+
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+
+double fewerFaults(const Scenario&, const StatsTable& stats) {
+    double faults = 0;
+    for (const auto& [comp, stat] : stats) faults += stat.totalFaults;
+    return -faults;
+}
+
+double fewerChargers(const Scenario& scenario, const StatsTable&) {
+    return -scenario.numChargers;
+}
+
+namespace {
+
+struct Genome {
+    int chargers;
+    std::vector<int> mix;
+    std::string key() const {
+        std::string k = std::to_string(chargers);
+        for (int n : mix) k += "," + std::to_string(n);
+        return k;
+    }
+};
+
+bool dominates(const std::vector<double>& a, const std::vector<double>& b) {
+    bool better = false;
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (a[k] < b[k]) return false;
+        if (a[k] > b[k]) better = true;
+    }
+    return better;
+}
+
+// Non-dominated sorting: rank 0 is the front, rank 1 the front once rank 0
+// is removed, and so on.
+std::vector<int> paretoRanks(const std::vector<std::vector<double>>& points) {
+    size_t n = points.size();
+    std::vector<int> rank(n, -1), dominatedBy(n);
+    std::vector<std::vector<size_t>> dominating(n);
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < n; ++j) {
+            if (dominates(points[i], points[j])) dominating[i].push_back(j);
+            else if (dominates(points[j], points[i])) dominatedBy[i]++;
+        }
+    std::vector<size_t> current;
+    for (size_t i = 0; i < n; ++i)
+        if (dominatedBy[i] == 0) current.push_back(i);
+    for (int r = 0; !current.empty(); ++r) {
+        std::vector<size_t> next;
+        for (size_t i : current) {
+            rank[i] = r;
+            for (size_t j : dominating[i])
+                if (--dominatedBy[j] == 0) next.push_back(j);
+        }
+        current = std::move(next);
+    }
+    return rank;
+}
+
+// Crowding distance within each rank: boundary points are infinitely far,
+// the rest sum the normalised gaps to their neighbours in every objective.
+std::vector<double> crowding(const std::vector<std::vector<double>>& points, const std::vector<int>& rank) {
+    size_t n = points.size();
+    std::vector<double> distance(n);
+    if (n == 0) return distance;
+    int maxRank = *std::max_element(rank.begin(), rank.end());
+    for (int r = 0; r <= maxRank; ++r) {
+        std::vector<size_t> members;
+        for (size_t i = 0; i < n; ++i)
+            if (rank[i] == r) members.push_back(i);
+        for (size_t k = 0; k < points[0].size(); ++k) {
+            std::sort(members.begin(), members.end(), [&](size_t a, size_t b) { return points[a][k] < points[b][k]; });
+            double span = points[members.back()][k] - points[members.front()][k];
+            distance[members.front()] = distance[members.back()] = std::numeric_limits<double>::infinity();
+            for (size_t m = 1; m + 1 < members.size(); ++m)
+                if (span > 0) distance[members[m]] += (points[members[m + 1]][k] - points[members[m - 1]][k]) / span;
+        }
+    }
+    return distance;
+}
+
+// Rejects options that admit no candidate; repair() would otherwise never
+// finish when the per-type minimums alone exceed the fleet.
+void validate(const Scenario& base, const std::vector<Objective>& objectives, const OptimizerOptions& options) {
+    if (objectives.empty()) throw std::runtime_error("the optimizer needs at least one objective");
+    if (base.vehicleTypes.empty()) throw std::runtime_error("the optimizer needs at least one vehicle type");
+    if (options.minChargers < 1 || options.minChargers > options.maxChargers)
+        throw std::runtime_error("charger bounds must satisfy 1 <= minChargers <= maxChargers");
+    if (options.fleetSize < 1 || options.minPerType < 0)
+        throw std::runtime_error("fleetSize must be positive and minPerType non-negative");
+    if (double(options.minPerType) * base.vehicleTypes.size() > options.fleetSize)
+        throw std::runtime_error("minPerType " + std::to_string(options.minPerType) + " for " +
+                                 std::to_string(base.vehicleTypes.size()) + " types exceeds fleetSize " +
+                                 std::to_string(options.fleetSize));
+    if (options.population < 1 || options.generations < 0 || options.replications < 1)
+        throw std::runtime_error("population and replications must be positive and generations non-negative");
+}
+
+class Search {
+public:
+    Search(const Scenario& base, const std::vector<Objective>& objectives, const OptimizerOptions& options)
+        : base(base), objectives(objectives), options(options), rng(options.seed) {}
+
+    ParetoResult run();
+
+private:
+    Genome randomGenome();
+    void repair(Genome& g);
+    Genome offspring(const std::vector<Genome>& parents, const std::vector<int>& rank,
+                     const std::vector<double>& distance);
+    Scenario scenarioOf(const Genome& g) const;
+    std::vector<double> score(const Scenario& scenario, const StatsTable& stats) const;
+    void evaluate(const std::vector<Genome>& genomes);
+    bool rejectedByFront(const std::vector<double>& analytic) const;
+
+    const Scenario& base;
+    const std::vector<Objective>& objectives;
+    const OptimizerOptions& options;
+    std::default_random_engine rng;
+    std::map<std::string, Candidate> memo;
+    ParetoResult result;
+};
+
+Genome Search::randomGenome() {
+    std::uniform_int_distribution<int> chargers(options.minChargers, options.maxChargers);
+    Genome g{chargers(rng), std::vector<int>(base.vehicleTypes.size(), options.minPerType)};
+    repair(g);
+    return g;
+}
+
+// Moves random vehicles in or out until the mix sums to the fleet size and
+// respects the per-type minimum; clamps the charger count.
+void Search::repair(Genome& g) {
+    g.chargers = std::min(std::max(g.chargers, options.minChargers), options.maxChargers);
+    std::uniform_int_distribution<size_t> type(0, g.mix.size() - 1);
+    for (int& n : g.mix) n = std::max(n, options.minPerType);
+    int total = std::accumulate(g.mix.begin(), g.mix.end(), 0);
+    for (; total < options.fleetSize; ++total) g.mix[type(rng)]++;
+    while (total > options.fleetSize) {
+        size_t t = type(rng);
+        if (g.mix[t] > options.minPerType) {
+            g.mix[t]--;
+            total--;
+        }
+    }
+}
+
+Genome Search::offspring(const std::vector<Genome>& parents, const std::vector<int>& rank,
+                         const std::vector<double>& distance) {
+    std::uniform_int_distribution<size_t> pick(0, parents.size() - 1);
+    auto tournament = [&] {
+        size_t a = pick(rng), b = pick(rng);
+        if (rank[a] != rank[b]) return rank[a] < rank[b] ? a : b;
+        return distance[a] >= distance[b] ? a : b;
+    };
+    const Genome& x = parents[tournament()];
+    const Genome& y = parents[tournament()];
+    std::bernoulli_distribution coin(0.5), mutate(options.mutationRate);
+
+    Genome child{coin(rng) ? x.chargers : y.chargers, x.mix};
+    for (size_t t = 0; t < child.mix.size(); ++t)
+        if (coin(rng)) child.mix[t] = y.mix[t];
+    if (mutate(rng)) child.chargers += coin(rng) ? 1 : -1;
+    if (mutate(rng)) {
+        std::uniform_int_distribution<size_t> type(0, child.mix.size() - 1);
+        size_t from = type(rng), to = type(rng);
+        int moved = std::min(child.mix[from] - options.minPerType, 1 + int(rng() % 2));
+        child.mix[from] -= std::max(moved, 0);
+        child.mix[to] += std::max(moved, 0);
+    }
+    repair(child);
+    return child;
+}
+
+Scenario Search::scenarioOf(const Genome& g) const {
+    Scenario s = base;
+    s.numChargers = g.chargers;
+    s.fleetMix = g.mix;
+    s.numVehicles = options.fleetSize;
+    s.commonRandomNumbers = true;
+    return s;
+}
+
+std::vector<double> Search::score(const Scenario& scenario, const StatsTable& stats) const {
+    std::vector<double> y;
+    for (const auto& objective : objectives) y.push_back(objective(scenario, stats));
+    return y;
+}
+
+bool Search::rejectedByFront(const std::vector<double>& analytic) const {
+    for (const auto& [key, c] : memo) {
+        if (!c.simulated) continue;
+        bool clear = true;
+        for (size_t k = 0; k < analytic.size() && clear; ++k)
+            clear = c.objectives[k] >= analytic[k] + options.rejectMargin * std::abs(c.objectives[k]);
+        if (clear) return true;
+    }
+    return false;
+}
+
+// New genomes are screened analytically against the simulated candidates
+// so far, then every survivor's replications run in one batch.
+void Search::evaluate(const std::vector<Genome>& genomes) {
+    std::vector<std::string> pending;
+    std::vector<Scenario> runs;
+    for (const Genome& g : genomes) {
+        std::string key = g.key();
+        if (memo.count(key)) {
+            result.memoized++;
+            continue;
+        }
+        Candidate& c = memo[key];
+        c.scenario = scenarioOf(g);
+        result.evaluations++;
+        std::vector<double> analytic = score(c.scenario, estimateChargers(c.scenario).expectedStats);
+        if (rejectedByFront(analytic)) {
+            c.objectives = analytic;
+            result.rejected++;
+            continue;
+        }
+        pending.push_back(key);
+        for (int r = 0; r < options.replications; ++r) {
+            runs.push_back(c.scenario);
+            runs.back().seed = replicationSeed(base.seed, r);
+        }
+    }
+
+    std::vector<StatsTable> stats = runBatch(runs, options.threads, options.cache);
+    for (size_t p = 0; p < pending.size(); ++p) {
+        Candidate& c = memo[pending[p]];
+        c.objectives.assign(objectives.size(), 0.0);
+        for (int r = 0; r < options.replications; ++r) {
+            std::vector<double> y = score(c.scenario, stats[p * options.replications + r]);
+            for (size_t k = 0; k < y.size(); ++k) c.objectives[k] += y[k] / options.replications;
+        }
+        c.simulated = true;
+        result.simulated++;
+    }
+}
+
+ParetoResult Search::run() {
+    std::vector<Genome> population;
+    if (base.fleetMix.size() == base.vehicleTypes.size()) {
+        Genome g{base.numChargers, base.fleetMix};
+        repair(g);
+        population.push_back(g);
+    }
+    while (int(population.size()) < options.population) population.push_back(randomGenome());
+    evaluate(population);
+
+    for (int gen = 0; gen < options.generations; ++gen) {
+        auto objectivesOf = [&](const std::vector<Genome>& gs) {
+            std::vector<std::vector<double>> ys;
+            for (const Genome& g : gs) {
+                const Candidate& c = memo.at(g.key());
+                // Rejected candidates rank behind every simulated one.
+                ys.push_back(c.simulated ? c.objectives
+                                         : std::vector<double>(objectives.size(), -std::numeric_limits<double>::max()));
+            }
+            return ys;
+        };
+        std::vector<std::vector<double>> ys = objectivesOf(population);
+        std::vector<int> rank = paretoRanks(ys);
+        std::vector<double> distance = crowding(ys, rank);
+
+        std::vector<Genome> children;
+        for (int i = 0; i < options.population; ++i) children.push_back(offspring(population, rank, distance));
+        evaluate(children);
+
+        // Survivors: best ranks first, wider crowding distance within a rank,
+        // each configuration once.
+        std::vector<Genome> pool;
+        std::set<std::string> seen;
+        for (const auto& g : population) if (seen.insert(g.key()).second) pool.push_back(g);
+        for (const auto& g : children) if (seen.insert(g.key()).second) pool.push_back(g);
+        ys = objectivesOf(pool);
+        rank = paretoRanks(ys);
+        distance = crowding(ys, rank);
+        std::vector<size_t> order(pool.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            if (rank[a] != rank[b]) return rank[a] < rank[b];
+            return distance[a] > distance[b];
+        });
+        population.clear();
+        for (size_t i = 0; i < order.size() && int(population.size()) < options.population; ++i)
+            population.push_back(pool[order[i]]);
+    }
+
+    std::vector<Candidate> simulated;
+    for (const auto& [key, c] : memo)
+        if (c.simulated) simulated.push_back(c);
+    std::vector<std::vector<double>> ys;
+    for (const auto& c : simulated) ys.push_back(c.objectives);
+    std::vector<int> rank = paretoRanks(ys);
+    for (size_t i = 0; i < simulated.size(); ++i)
+        if (rank[i] == 0) result.front.push_back(simulated[i]);
+    std::sort(result.front.begin(), result.front.end(), [](const Candidate& a, const Candidate& b) {
+        if (a.scenario.numChargers != b.scenario.numChargers) return a.scenario.numChargers < b.scenario.numChargers;
+        return a.scenario.fleetMix < b.scenario.fleetMix;
+    });
+    return result;
+}
+
+}
+
+ParetoResult optimizeFleet(const Scenario& base, const std::vector<Objective>& objectives,
+                           const OptimizerOptions& options) {
+    validate(base, objectives, options);
+    return Search(base, objectives, options).run();
+}
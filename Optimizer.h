@@ -0,0 +1,51 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "Sweep.h"
+
+// More objectives, all higher-is-better like the others.
+double fewerFaults(const Scenario& scenario, const StatsTable& stats);
+double fewerChargers(const Scenario& scenario, const StatsTable& stats);
+
+struct OptimizerOptions {
+    int minChargers = 1;
+    int maxChargers = 8;
+    int fleetSize = NUM_VEHICLES;
+    int minPerType = 0;
+    int population = 24;
+    int generations = 15;
+    int replications = 4;
+    double mutationRate = 0.3;
+    // A candidate whose analytic (MVA) objectives trail some simulated
+    // front member by this fraction in every objective is not simulated.
+    double rejectMargin = 0.1;
+    unsigned seed = std::random_device()();
+    int threads = std::thread::hardware_concurrency();
+    ResultCache* cache = nullptr;
+};
+
+struct Candidate {
+    Scenario scenario;
+    std::vector<double> objectives;  // simulated mean, or analytic when rejected
+    bool simulated = false;
+};
+
+struct ParetoResult {
+    std::vector<Candidate> front;    // non-dominated simulated candidates, most chargers last
+    int evaluations = 0;             // distinct candidates generated
+    int simulated = 0;
+    int rejected = 0;
+    int memoized = 0;                // repeats served from earlier evaluations
+};
+
+// NSGA-II style search over the charger count and the fleet mix (fleetSize
+// vehicles split between base's vehicle types). Each generation's new
+// candidates are screened with the queueing model, and the survivors'
+// replications run as one parallel batch. Candidates share replication
+// seeds with common random numbers, so they are compared on equal luck.
+// Throws std::runtime_error when the options admit no candidate, e.g. when
+// minPerType over all types exceeds fleetSize.
+ParetoResult optimizeFleet(const Scenario& base, const std::vector<Objective>& objectives,
+                           const OptimizerOptions& options = OptimizerOptions());
+
+#endif
@@ -0,0 +1,78 @@
+#include "QueueingModel.h"
+
+#include <cmath>
+
+ChargerEstimate estimateChargers(const Scenario& scenario) {
+    size_t n = scenario.vehicleTypes.size();
+    int c = std::max(1, scenario.numChargers);
+    std::vector<double> population(n), flight(n), service(n);
+    for (size_t i = 0; i < n; ++i) {
+        const VehicleType& t = scenario.vehicleTypes[i];
+        population[i] = scenario.fleetMix.empty() ? double(scenario.numVehicles) / n : scenario.fleetMix[i];
+        flight[i] = t.batteryCapacity / (t.cruiseSpeed * t.energyPerMile);
+        service[i] = t.timeToCharge;
+    }
+
+    // Seidmann: c servers of demand s behave like one server of demand s / c
+    // followed by a pure delay of s (c - 1) / c.
+    std::vector<double> queue(n), residence(n), throughput(n);
+    for (size_t i = 0; i < n; ++i) queue[i] = population[i] / 2;
+    for (int iter = 0; iter < 1000; ++iter) {
+        double total = 0;
+        for (double q : queue) total += q;
+        double delta = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (population[i] <= 0) {
+                throughput[i] = residence[i] = 0;
+                continue;
+            }
+            double seen = total - queue[i] / population[i];
+            residence[i] = service[i] / c * (1 + seen);
+            double delay = flight[i] + service[i] * (c - 1) / c;
+            throughput[i] = population[i] / (delay + residence[i]);
+            double q = throughput[i] * residence[i];
+            delta = std::max(delta, std::abs(q - queue[i]));
+            queue[i] = q;
+        }
+        if (delta < 1e-9 * std::max(1.0, total)) break;
+    }
+
+    ChargerEstimate e;
+    e.numChargers = scenario.numChargers;
+    e.throughput = throughput;
+    for (size_t i = 0; i < n; ++i) {
+        const VehicleType& t = scenario.vehicleTypes[i];
+        e.utilization += throughput[i] * service[i] / c;
+        e.waitingTime.push_back(std::max(0.0, residence[i] + service[i] * (c - 1) / c - service[i]));
+
+        double flights = throughput[i] * scenario.duration;
+        double distance = t.cruiseSpeed * flight[i];
+        Stats& s = e.expectedStats[t.company];
+        s.totalFlightTime += flights * flight[i];
+        s.totalDistance += flights * distance;
+        s.passengerMiles += flights * t.passengerCount * distance;
+        s.totalChargeTime += flights * service[i];
+        s.totalFlights += std::llround(flights);
+        s.totalCharges += std::llround(flights);
+        double faultProb = std::min(t.faultProbPerHour * flight[i], 1.0);
+        s.totalFaults += std::llround(flights * faultProb);
+        s.expectedFaults += flights * faultProb;
+    }
+    return e;
+}
+
+std::vector<ChargerEstimate> chargerCurve(const Scenario& scenario, int minChargers, int maxChargers) {
+    std::vector<ChargerEstimate> curve;
+    Scenario s = scenario;
+    for (s.numChargers = minChargers; s.numChargers <= maxChargers; ++s.numChargers)
+        curve.push_back(estimateChargers(s));
+    return curve;
+}
+
+bool passesScreen(const ChargerEstimate& estimate, const ScreeningCriteria& criteria) {
+    if (estimate.utilization < criteria.minUtilization || estimate.utilization > criteria.maxUtilization)
+        return false;
+    for (double w : estimate.waitingTime)
+        if (w > criteria.maxWaitingTime) return false;
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef QUEUEING_MODEL_H
+#define QUEUEING_MODEL_H
+
+#include "eVTOLSimulation.h"
+
+// Steady-state estimate for one charger count. Per-type vectors follow
+// Scenario::vehicleTypes; waitingTime is hours queued per charge.
+struct ChargerEstimate {
+    int numChargers = 0;
+    double utilization = 0;
+    std::vector<double> throughput;
+    std::vector<double> waitingTime;
+    std::map<Company, Stats> expectedStats;
+};
+
+struct ScreeningCriteria {
+    double minUtilization = 0.2;
+    double maxUtilization = 0.95;
+    double maxWaitingTime = 1.0;
+};
+
+// Closed queueing network: every vehicle cycles through an infinite-server
+// flight stage and the shared charger pool. Solved by Schweitzer approximate
+// MVA with Seidmann's multi-server correction, so the cost is a few dozen
+// iterations over the vehicle types regardless of fleet size.
+ChargerEstimate estimateChargers(const Scenario& scenario);
+std::vector<ChargerEstimate> chargerCurve(const Scenario& scenario, int minChargers, int maxChargers);
+bool passesScreen(const ChargerEstimate& estimate, const ScreeningCriteria& criteria = ScreeningCriteria());
+
+#endif
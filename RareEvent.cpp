@@ -0,0 +1,103 @@
+#include "RareEvent.h"
+#include "QueueingModel.h"
+
+#include <cmath>
+
+namespace {
+
+long long faultsOf(const Simulation& sim, Company company) {
+    auto it = sim.getStats().find(company);
+    return it == sim.getStats().end() ? 0 : it->second.totalFaults;
+}
+
+}
+
+TailEstimate faultTailProbability(const Scenario& scenario, Company company, int threshold, int replications,
+                                  double tilt, int threads) {
+    if (tilt <= 0) {
+        auto expected = estimateChargers(scenario).expectedStats;
+        Stats s = expected.count(company) ? expected[company] : Stats();
+        double flights = s.totalFlights;
+        tilt = 1.0;
+        if (flights > 0 && s.expectedFaults > 0 && threshold > s.expectedFaults) {
+            double p = s.expectedFaults / flights;
+            double q = std::min<double>(threshold, flights - 0.5) / flights;
+            tilt = std::max(1.0, q / (1 - q) * (1 - p) / p);
+        }
+    }
+    Scenario tilted = scenario;
+    tilted.faultTilt[company] = tilt;
+
+    std::vector<double> weight(std::max(replications, 0));
+    parallelFor(weight.size(), threads, [&](int r) {
+        Scenario run = tilted;
+        run.seed = replicationSeed(scenario.seed, r);
+        Simulation sim(run);
+        sim.runUntil(run.duration);
+        weight[r] = faultsOf(sim, company) >= threshold ? sim.likelihoodRatio() : 0.0;
+    });
+
+    TailEstimate e;
+    e.runs = replications;
+    RunningMoments m;
+    double sumSq = 0;
+    for (double w : weight) {
+        m.add(w);
+        sumSq += w * w;
+    }
+    e.probability = m.mean;
+    if (m.mean > 0) {
+        e.relativeError = std::sqrt(m.variance() / m.count) / m.mean;
+        e.effectiveSamples = m.mean * m.count * m.mean * m.count / sumSq;
+    }
+    return e;
+}
+
+LevelFunction faultLevel(Company company) {
+    return [company](const Simulation& sim) { return double(faultsOf(sim, company)); };
+}
+
+TailEstimate splittingProbability(const Scenario& scenario, const LevelFunction& level,
+                                  const SplittingOptions& options) {
+    TailEstimate e;
+    int n = std::max(1, options.trialsPerLevel);
+    std::vector<std::vector<char>> starts;
+    double probability = 1, relativeVariance = 0;
+
+    for (size_t k = 0; k < options.levels.size(); ++k) {
+        std::vector<std::vector<char>> hits(n);
+        std::vector<char> hit(n);
+        unsigned stageSeed = replicationSeed(scenario.seed, k);
+        parallelFor(n, options.threads, [&](int j) {
+            Scenario run = scenario;
+            run.seed = replicationSeed(stageSeed, j);
+            Simulation sim(run);
+            if (k > 0) {
+                const auto& from = starts[j % starts.size()];
+                sim.restore(from.data(), from.size());
+                sim.reseed(run.seed);
+            }
+            while (level(sim) < options.levels[k] && sim.currentTime() < scenario.duration)
+                sim.runUntil(std::min(sim.currentTime() + options.checkInterval, scenario.duration));
+            if (level(sim) >= options.levels[k]) {
+                hits[j] = sim.snapshot();
+                hit[j] = 1;
+            }
+        });
+        e.runs += n;
+
+        starts.clear();
+        for (int j = 0; j < n; ++j)
+            if (hit[j]) starts.push_back(std::move(hits[j]));
+        double p = double(starts.size()) / n;
+        probability *= p;
+        if (starts.empty()) break;
+        relativeVariance += (1 - p) / (n * p);
+    }
+
+    e.probability = options.levels.empty() ? 0 : probability;
+    if (e.probability > 0) e.relativeError = std::sqrt(relativeVariance);
+    // Plain Monte Carlo runs that would give the same relative error.
+    if (relativeVariance > 0) e.effectiveSamples = (1 - e.probability) / (e.probability * relativeVariance);
+    return e;
+}
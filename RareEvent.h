@@ -0,0 +1,41 @@
+#ifndef RARE_EVENT_H
+#define RARE_EVENT_H
+
+#include "Replication.h"
+
+struct TailEstimate {
+    double probability = 0;
+    double relativeError = 0;     // standard error over probability
+    double effectiveSamples = 0;
+    int runs = 0;
+};
+
+// P(company has at least `threshold` faults over the horizon) by importance
+// sampling: the odds of the company's per-flight fault are multiplied by
+// `tilt` and every run is weighted by its likelihood ratio. tilt <= 0 picks
+// the tilt that moves the analytic expected fault count onto the threshold.
+// The weights come from the live runs, so these runs never use a ResultCache.
+TailEstimate faultTailProbability(const Scenario& scenario, Company company, int threshold, int replications,
+                                  double tilt = 0, int threads = std::thread::hardware_concurrency());
+
+// Level of a running simulation; must not decrease over a run.
+using LevelFunction = std::function<double(const Simulation&)>;
+LevelFunction faultLevel(Company company);
+
+struct SplittingOptions {
+    std::vector<double> levels;   // increasing; the last is the rare event
+    int trialsPerLevel = 100;
+    double checkInterval = 1.0 / 60;
+    int threads = std::thread::hardware_concurrency();
+};
+
+// Fixed-effort multilevel splitting: trials that reach a level are
+// snapshotted, and the next stage restarts trialsPerLevel clones from those
+// states with fresh seeds. The estimate is the product of the per-level
+// hit fractions. Only the fault draws are random once the fleet is drawn,
+// so levels should follow faults; a level on queue length would make every
+// stage after the first deterministic.
+TailEstimate splittingProbability(const Scenario& scenario, const LevelFunction& level,
+                                  const SplittingOptions& options);
+
+#endif
@@ -0,0 +1,191 @@
+#include "Replication.h"
+
+#include <cmath>
+#include <set>
+
+unsigned replicationSeed(unsigned base, int replication) {
+    return unsigned(counterUniform(base, NUM_STREAMS, replication) * 4294967296.0);
+}
+
+std::vector<StatsTable> runBatch(const std::vector<Scenario>& runs, int threads, ResultCache* cache) {
+    int count = runs.size();
+    std::vector<StatsTable> results(count);
+    parallelFor(count, threads, [&](size_t i) {
+        if (cache && cache->lookup(runs[i], results[i])) return;
+        Simulation sim(runs[i]);
+        sim.runUntil(runs[i].duration);
+        results[i] = sim.getStats();
+        if (cache) cache->store(runs[i], results[i]);
+    });
+    return results;
+}
+
+std::vector<StatsTable> runReplications(const Scenario& scenario, int replications, int threads,
+                                        int firstReplication, ResultCache* cache) {
+    std::vector<Scenario> runs(std::max(replications, 0), scenario);
+    for (int r = 0; r < replications; ++r)
+        runs[r].seed = replicationSeed(scenario.seed, firstReplication + r);
+    return runBatch(runs, threads, cache);
+}
+
+void RunningMoments::add(double x) {
+    count++;
+    double delta = x - mean;
+    mean += delta / count;
+    m2 += delta * (x - mean);
+}
+
+void RunningMoments::merge(const RunningMoments& other) {
+    if (other.count == 0) return;
+    long long n = count + other.count;
+    double delta = other.mean - mean;
+    mean += delta * other.count / n;
+    m2 += other.m2 + delta * delta * double(count) * other.count / n;
+    count = n;
+}
+
+double RunningMoments::variance() const { return count > 1 ? m2 / (count - 1) : 0.0; }
+
+double RunningMoments::halfWidth(double z) const {
+    return count > 1 ? z * std::sqrt(variance() / count) : INFINITY;
+}
+
+const std::vector<std::string> statsFieldNames = {
+    "flight time", "distance", "charge time", "passenger-miles", "flights", "charges", "faults"
+};
+
+double statsField(const Stats& s, StatsField field) {
+    switch (field) {
+        case FLIGHT_TIME: return s.totalFlightTime;
+        case DISTANCE: return s.totalDistance;
+        case CHARGE_TIME: return s.totalChargeTime;
+        case PASSENGER_MILES: return s.passengerMiles;
+        case FLIGHTS: return s.totalFlights;
+        case CHARGES: return s.totalCharges;
+        case FAULTS: return s.totalFaults;
+        default: return 0;
+    }
+}
+
+double SequentialResult::varianceReduction(Company company, StatsField field) const {
+    double reduced = moments.at(company)[field].variance() * runsPerObservation;
+    return reduced > 0 ? plain.at(company)[field].variance() / reduced : INFINITY;
+}
+
+StatsTable SequentialResult::mean() const {
+    StatsTable table;
+    for (const auto& [comp, m] : moments) {
+        Stats& s = table[comp];
+        s.totalFlightTime = m[FLIGHT_TIME].mean;
+        s.totalDistance = m[DISTANCE].mean;
+        s.totalChargeTime = m[CHARGE_TIME].mean;
+        s.passengerMiles = m[PASSENGER_MILES].mean;
+        s.totalFlights = std::llround(m[FLIGHTS].mean);
+        s.totalCharges = std::llround(m[CHARGES].mean);
+        s.totalFaults = std::llround(m[FAULTS].mean);
+        s.expectedFaults = m[FAULTS].mean;
+    }
+    return table;
+}
+
+namespace {
+
+using CompanyMoments = std::map<Company, std::array<RunningMoments, NUM_STATS_FIELDS>>;
+
+// Two-sided standard normal quantile for the given confidence, by bisection.
+double normalQuantile(double confidence) {
+    double lo = 0, hi = 10;
+    for (int i = 0; i < 100; ++i) {
+        double mid = (lo + hi) / 2;
+        (std::erfc(mid / std::sqrt(2.0)) > 1 - confidence ? lo : hi) = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+using CompanyValues = std::map<Company, std::array<double, NUM_STATS_FIELDS>>;
+
+// One observation of the estimator: a single run, or the mean of an
+// antithetic pair sharing a seed. With the control variate the fault count
+// is replaced by its expectation given the flights flown. Faults do not
+// feed back into the dynamics, so faults - expectedFaults has mean zero and
+// is uncorrelated with expectedFaults, which makes the optimal control
+// coefficient exactly 1 and needs no estimate. Each run's raw values also
+// go to `plain`. A company with no vehicles in a run contributes zeros.
+CompanyValues observe(const Scenario& scenario, int index, const VarianceReduction& reduction,
+                      const std::set<Company>& companies, CompanyMoments& plain, ResultCache* cache) {
+    int runs = reduction.antithetic ? 2 : 1;
+    CompanyValues values;
+    for (int k = 0; k < runs; ++k) {
+        Scenario run = scenario;
+        run.seed = replicationSeed(scenario.seed, index);
+        run.antitheticFaults = k == 1;
+        StatsTable stats = runBatch({run}, 1, cache).front();
+        for (Company comp : companies) {
+            auto it = stats.find(comp);
+            Stats s = it == stats.end() ? Stats() : it->second;
+            for (int f = 0; f < NUM_STATS_FIELDS; ++f) {
+                double x = statsField(s, StatsField(f));
+                plain[comp][f].add(x);
+                if (f == FAULTS && reduction.controlVariate) x = s.expectedFaults;
+                values[comp][f] += x / runs;
+            }
+        }
+    }
+    return values;
+}
+
+void merge(CompanyMoments& into, const CompanyMoments& from) {
+    for (const auto& [comp, m] : from)
+        for (int f = 0; f < NUM_STATS_FIELDS; ++f) into[comp][f].merge(m[f]);
+}
+
+bool precise(const CompanyMoments& moments, const PrecisionTarget& target, double z) {
+    for (const auto& [comp, m] : moments)
+        for (StatsField f : target.fields)
+            if (m[f].halfWidth(z) > target.relativeHalfWidth * std::abs(m[f].mean)) return false;
+    return true;
+}
+
+}
+
+// Each observation is folded into its own moments; they are merged in
+// observation order after every batch and checked, so the result does not
+// depend on the thread count.
+SequentialResult runUntilPrecise(const Scenario& scenario, const PrecisionTarget& target) {
+    int threads = std::max(1, target.threads);
+    int batch = target.batch > 0 ? target.batch : threads;
+    double z = normalQuantile(target.confidence);
+    std::set<Company> companies;
+    for (const auto& type : scenario.vehicleTypes) companies.insert(type.company);
+    SequentialResult result;
+    result.runsPerObservation = target.reduction.antithetic ? 2 : 1;
+    int per = result.runsPerObservation;
+
+    while (result.replications < target.maxReplications) {
+        int first = result.replications / per;
+        int runs = std::min(batch, target.maxReplications - result.replications);
+        if (result.replications < target.minReplications)
+            runs = std::max(runs, target.minReplications - result.replications);
+        int count = std::max(1, runs / per);
+
+        std::vector<std::pair<CompanyMoments, CompanyMoments>> partial(count);
+        parallelFor(count, threads, [&](size_t o) {
+            auto& local = partial[o];
+            CompanyValues values = observe(scenario, first + o, target.reduction, companies, local.second,
+                                           target.cache);
+            for (const auto& [comp, x] : values)
+                for (int f = 0; f < NUM_STATS_FIELDS; ++f) local.first[comp][f].add(x[f]);
+        });
+
+        for (const auto& local : partial) {
+            merge(result.moments, local.first);
+            merge(result.plain, local.second);
+        }
+        result.replications += count * per;
+        if (result.replications >= target.minReplications && precise(result.moments, target, z)) {
+            result.converged = true;
+            break;
+        }
+    }
+    return result;
+}
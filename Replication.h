@@ -0,0 +1,110 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "ResultCache.h"
+
+#include <array>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+// Calls job(i) for every i < n on up to `threads` threads, the caller's
+// among them. The first job to throw stops the rest; its exception is
+// rethrown once every thread has been joined.
+template <typename Job>
+void parallelFor(size_t n, int threads, const Job& job) {
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    auto worker = [&] {
+        try {
+            for (size_t i; (i = next++) < n;) job(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+            next = n;
+        }
+    };
+    std::vector<std::thread> pool;
+    size_t count = std::max<size_t>(1, std::min<size_t>(std::max(threads, 1), n));
+    for (size_t t = 1; t < count; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+    if (error) std::rethrow_exception(error);
+}
+
+// Seed of replication r of a scenario; distinct replications never share
+// a stream and the mapping does not depend on the thread count.
+unsigned replicationSeed(unsigned base, int replication);
+
+// Runs every scenario (seed as given) to its horizon across threads. With a
+// cache, runs already in it are not repeated and new results are added.
+std::vector<StatsTable> runBatch(const std::vector<Scenario>& runs,
+                                 int threads = std::thread::hardware_concurrency(),
+                                 ResultCache* cache = nullptr);
+
+// Runs independent replications of a scenario (to its horizon) across
+// threads. Result r comes from replicationSeed(scenario.seed,
+// firstReplication + r), so a later call can extend an earlier one.
+std::vector<StatsTable> runReplications(const Scenario& scenario, int replications,
+                                        int threads = std::thread::hardware_concurrency(),
+                                        int firstReplication = 0, ResultCache* cache = nullptr);
+
+// Welford running mean and sum of squared deviations; merge() combines two
+// partial accumulations (Chan et al.), so threads can keep their own.
+struct RunningMoments {
+    long long count = 0;
+    double mean = 0;
+    double m2 = 0;
+    void add(double x);
+    void merge(const RunningMoments& other);
+    double variance() const;
+    double halfWidth(double z) const;  // of the confidence interval on the mean
+};
+
+enum StatsField { FLIGHT_TIME, DISTANCE, CHARGE_TIME, PASSENGER_MILES, FLIGHTS, CHARGES, FAULTS, NUM_STATS_FIELDS };
+using FieldValues = std::array<double, NUM_STATS_FIELDS>;
+extern const std::vector<std::string> statsFieldNames;
+double statsField(const Stats& stats, StatsField field);
+
+// antithetic: replications come in pairs sharing a seed, the second with
+// antitheticFaults. The pair shares its fleet draw too, so this pays off
+// with a fixed fleetMix; otherwise the reported reduction shows the cost.
+// controlVariate: the fault count is adjusted with its
+// known conditional expectation, Stats::expectedFaults.
+struct VarianceReduction {
+    bool antithetic = false;
+    bool controlVariate = false;
+};
+
+struct PrecisionTarget {
+    std::vector<StatsField> fields = {PASSENGER_MILES};
+    double relativeHalfWidth = 0.01;   // per company and field, of the mean
+    double confidence = 0.95;
+    int minReplications = 10;
+    int maxReplications = 1000;
+    int batch = 0;                     // replications between checks; 0: one per thread
+    int threads = std::thread::hardware_concurrency();
+    VarianceReduction reduction;
+    ResultCache* cache = nullptr;
+};
+
+struct SequentialResult {
+    std::map<Company, std::array<RunningMoments, NUM_STATS_FIELDS>> moments;  // of the adjusted estimator
+    std::map<Company, std::array<RunningMoments, NUM_STATS_FIELDS>> plain;    // of the individual runs
+    int runsPerObservation = 1;
+    int replications = 0;
+    bool converged = false;
+    StatsTable mean() const;
+    // Runs plain Monte Carlo would need per run of the adjusted estimator
+    // for the same precision.
+    double varianceReduction(Company company, StatsField field) const;
+};
+
+// Runs replications in batches until every requested field of every company
+// has a confidence interval within the target, or the maximum is reached.
+// Replication r is the same as in runReplications whatever the batching.
+SequentialResult runUntilPrecise(const Scenario& scenario, const PrecisionTarget& target = PrecisionTarget());
+
+#endif
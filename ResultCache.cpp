@@ -0,0 +1,195 @@
+#include "ResultCache.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+std::string sha256(const std::string& message) {
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    std::string data = message;
+    uint64_t bits = uint64_t(message.size()) * 8;
+    data += char(0x80);
+    while (data.size() % 64 != 56) data += char(0);
+    for (int i = 7; i >= 0; --i) data += char(bits >> (8 * i));
+
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data() + block + 4 * i);
+            w[i] = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+        }
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            k = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+        h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+    }
+
+    char hex[65];
+    for (int i = 0; i < 8; ++i) std::snprintf(hex + 8 * i, 9, "%08x", h[i]);
+    return std::string(hex, 64);
+}
+
+void makeDirectory(const std::string& path) {
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+        throw std::runtime_error("cannot create cache directory " + path + ": " + std::strerror(errno));
+}
+
+}
+
+std::string canonicalScenario(const Scenario& s) {
+    std::ostringstream os;
+    os << std::hexfloat;
+    for (const auto& t : s.vehicleTypes)
+        os << "type " << t.company << ' ' << t.cruiseSpeed << ' ' << t.batteryCapacity << ' ' << t.timeToCharge
+           << ' ' << t.energyPerMile << ' ' << t.passengerCount << ' ' << t.faultProbPerHour << '\n';
+    os << "vehicles " << s.numVehicles << "\nmix";
+    for (int n : s.fleetMix) os << ' ' << n;
+    os << "\nchargers " << s.numChargers << "\nduration " << s.duration << "\nseed " << s.seed
+       << "\ncrn " << s.commonRandomNumbers << "\nantithetic " << s.antitheticFaults << "\ntilt";
+    for (const auto& [comp, tilt] : s.faultTilt) os << ' ' << comp << ' ' << tilt;
+    os << '\n';
+    if (s.sitePower > 0) os << "power " << s.sitePower << ' ' << s.powerAllocation << '\n';
+    if (s.chargeKnee < 1 || s.departureCharge < 1)
+        os << "charge " << s.chargeKnee << ' ' << s.chargeCutoff << ' ' << s.departureCharge << '\n';
+    return os.str();
+}
+
+std::string scenarioHash(const Scenario& scenario) {
+    return sha256("engine " + std::to_string(ENGINE_VERSION) + "\n" + canonicalScenario(scenario));
+}
+
+ResultCache::ResultCache(std::string dir) : directory(std::move(dir)) {
+    makeDirectory(directory);
+}
+
+std::string ResultCache::path(const std::string& hash) const {
+    return directory + "/" + hash.substr(0, 2) + "/" + hash;
+}
+
+// File: a header line, the canonical scenario, a blank line, then one line
+// of hexfloat Stats fields per company.
+bool ResultCache::readFile(const std::string& canonical, const std::string& hash, StatsTable& stats) const {
+    std::ifstream in(path(hash));
+    if (!in) return false;
+    std::string line, text;
+    if (!std::getline(in, line) || line != "evtol-result " + std::to_string(ENGINE_VERSION)) return false;
+    while (std::getline(in, line) && !line.empty()) text += line + "\n";
+    if (text != canonical) return false;
+
+    StatsTable read;
+    int comp;
+    Stats s;
+    while (in >> comp) {
+        std::string fields[5];
+        for (auto& f : fields) in >> f;
+        in >> s.totalFlights >> s.totalCharges >> s.totalFaults;
+        s.totalFlightTime = std::strtod(fields[0].c_str(), nullptr);
+        s.totalDistance = std::strtod(fields[1].c_str(), nullptr);
+        s.totalChargeTime = std::strtod(fields[2].c_str(), nullptr);
+        s.passengerMiles = std::strtod(fields[3].c_str(), nullptr);
+        s.expectedFaults = std::strtod(fields[4].c_str(), nullptr);
+        read[Company(comp)] = s;
+    }
+    if (!in.eof()) return false;
+    stats = std::move(read);
+    return true;
+}
+
+void ResultCache::writeFile(const std::string& canonical, const std::string& hash, const StatsTable& stats) const {
+    static std::atomic<unsigned> counter{0};
+    makeDirectory(directory + "/" + hash.substr(0, 2));
+    std::string final = path(hash);
+    std::string temp = final + ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+    {
+        std::ofstream out(temp);
+        out << "evtol-result " << ENGINE_VERSION << "\n" << canonical << "\n" << std::hexfloat;
+        for (const auto& [comp, s] : stats)
+            out << int(comp) << ' ' << s.totalFlightTime << ' ' << s.totalDistance << ' ' << s.totalChargeTime
+                << ' ' << s.passengerMiles << ' ' << s.expectedFaults << ' ' << s.totalFlights << ' '
+                << s.totalCharges << ' ' << s.totalFaults << '\n';
+        if (!out.flush()) {
+            std::remove(temp.c_str());
+            throw std::runtime_error("cannot write cache file " + temp);
+        }
+    }
+    if (std::rename(temp.c_str(), final.c_str()) != 0) {
+        std::remove(temp.c_str());
+        throw std::runtime_error("cannot rename cache file into " + final);
+    }
+}
+
+bool ResultCache::lookup(const Scenario& scenario, StatsTable& stats) {
+    std::string key = canonicalScenario(scenario);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = results.find(key);
+        if (it != results.end()) {
+            stats = it->second.second;
+            hitCount++;
+            return true;
+        }
+    }
+    if (directory.empty() || !readFile(key, scenarioHash(scenario), stats)) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    results.emplace(std::move(key), std::make_pair(scenario, stats));
+    hitCount++;
+    diskHitCount++;
+    return true;
+}
+
+void ResultCache::store(const Scenario& scenario, const StatsTable& stats) {
+    std::string key = canonicalScenario(scenario);
+    if (!directory.empty()) writeFile(key, scenarioHash(scenario), stats);
+    std::lock_guard<std::mutex> lock(mutex);
+    results.emplace(std::move(key), std::make_pair(scenario, stats));
+}
+
+size_t ResultCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return results.size();
+}
+
+std::vector<std::pair<Scenario, StatsTable>> ResultCache::entries() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::pair<Scenario, StatsTable>> all;
+    for (const auto& [key, entry] : results) all.push_back(entry);
+    return all;
+}
@@ -0,0 +1,55 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "eVTOLSimulation.h"
+
+#include <mutex>
+#include <unordered_map>
+
+using StatsTable = std::map<Company, Stats>;
+
+// Every field a run's result depends on, in a fixed textual form: equal
+// strings mean equal results.
+std::string canonicalScenario(const Scenario& scenario);
+
+// Hex SHA-256 of the engine version and the canonical scenario.
+std::string scenarioHash(const Scenario& scenario);
+
+// Results of finished runs keyed by their canonical scenario; safe to share
+// between threads and between batches. Given a directory, results also go
+// to <directory>/<first two hash digits>/<hash>, written to a temporary
+// file and renamed into place, so any number of processes can share the
+// directory: readers only ever see complete files, and a result written
+// twice is written identically. Each file repeats the canonical scenario,
+// which is checked on read. entries() lists the results this object has
+// seen, not the whole directory.
+//
+// The batch runners, sweeps, comparisons, uncertainty and sensitivity
+// studies, the surrogate and the optimizer all take one. Rare-event
+// estimates and parareal do not: the former need each run's likelihood
+// ratio or mid-run state, which a Stats table does not hold, and parareal
+// windows are partial runs from lifted states rather than scenarios.
+class ResultCache {
+public:
+    ResultCache() = default;
+    explicit ResultCache(std::string directory);
+    bool lookup(const Scenario& scenario, StatsTable& stats);
+    void store(const Scenario& scenario, const StatsTable& stats);
+    size_t hits() const { return hitCount; }
+    size_t diskHits() const { return diskHitCount; }
+    size_t size() const;
+    std::vector<std::pair<Scenario, StatsTable>> entries() const;
+
+private:
+    std::string path(const std::string& hash) const;
+    bool readFile(const std::string& canonical, const std::string& hash, StatsTable& stats) const;
+    void writeFile(const std::string& canonical, const std::string& hash, const StatsTable& stats) const;
+
+    std::string directory;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::pair<Scenario, StatsTable>> results;
+    size_t hitCount = 0;
+    size_t diskHitCount = 0;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "Sensitivity.h"
+
+namespace {
+
+FieldValues fleetTotals(const StatsTable& stats) {
+    FieldValues x{};
+    for (const auto& [comp, s] : stats)
+        for (int f = 0; f < NUM_STATS_FIELDS; ++f) x[f] += statsField(s, StatsField(f));
+    return x;
+}
+
+}
+
+SensitivityIndices sobolIndices(const Scenario& base, const std::vector<ParameterRange>& ranges, int samples,
+                                ResultCache* cache, int threads) {
+    size_t k = ranges.size();
+    SobolSequence sobol(2 * k, base.seed);
+
+    // Run layout per sample row j: A, B, then AB_0 .. AB_{k-1}.
+    std::vector<Scenario> runs;
+    for (int j = 0; j < samples; ++j) {
+        std::vector<double> u = sobol.point(j);
+        Scenario row = base;
+        row.seed = replicationSeed(base.seed, j);
+        row.commonRandomNumbers = true;
+        Scenario a = row, b = row;
+        for (size_t i = 0; i < k; ++i) {
+            setParameter(a, ranges[i], u[i]);
+            setParameter(b, ranges[i], u[k + i]);
+        }
+        runs.push_back(a);
+        runs.push_back(b);
+        for (size_t i = 0; i < k; ++i) {
+            Scenario ab = a;
+            setParameter(ab, ranges[i], u[k + i]);
+            runs.push_back(ab);
+        }
+    }
+    size_t hitsBefore = cache ? cache->hits() : 0;
+    std::vector<StatsTable> results = runBatch(runs, threads, cache);
+
+    SensitivityIndices si;
+    si.runs = runs.size();
+    si.cachedRuns = cache ? cache->hits() - hitsBefore : 0;
+    si.firstOrder.assign(k, FieldValues{});
+    si.totalOrder.assign(k, FieldValues{});
+    std::array<RunningMoments, NUM_STATS_FIELDS> moments;
+    size_t stride = k + 2;
+    for (int j = 0; j < samples; ++j) {
+        FieldValues fa = fleetTotals(results[j * stride]);
+        FieldValues fb = fleetTotals(results[j * stride + 1]);
+        for (int f = 0; f < NUM_STATS_FIELDS; ++f) {
+            moments[f].add(fa[f]);
+            moments[f].add(fb[f]);
+        }
+        for (size_t i = 0; i < k; ++i) {
+            FieldValues fab = fleetTotals(results[j * stride + 2 + i]);
+            for (int f = 0; f < NUM_STATS_FIELDS; ++f) {
+                si.firstOrder[i][f] += fb[f] * (fab[f] - fa[f]);
+                si.totalOrder[i][f] += (fa[f] - fab[f]) * (fa[f] - fab[f]) / 2;
+            }
+        }
+    }
+    for (int f = 0; f < NUM_STATS_FIELDS; ++f) {
+        si.mean[f] = moments[f].mean;
+        si.variance[f] = moments[f].variance();
+        for (size_t i = 0; i < k; ++i) {
+            double v = si.variance[f] > 0 ? si.variance[f] * samples : 0;
+            si.firstOrder[i][f] = v > 0 ? si.firstOrder[i][f] / v : 0;
+            si.totalOrder[i][f] = v > 0 ? si.totalOrder[i][f] / v : 0;
+        }
+    }
+    return si;
+}
+
+void printSensitivity(const SensitivityIndices& si, const std::vector<ParameterRange>& ranges) {
+    std::cout << std::fixed << std::setprecision(3);
+    for (int f = 0; f < NUM_STATS_FIELDS; ++f) {
+        std::cout << statsFieldNames[f] << " (mean " << si.mean[f] << ", variance " << si.variance[f] << "):\n";
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            std::cout << "  " << parameterNames[ranges[i].parameter];
+            if (ranges[i].parameter < CHARGERS) std::cout << " (" << companyNames[ranges[i].company] << ")";
+            std::cout << ": first " << si.firstOrder[i][f] << ", total " << si.totalOrder[i][f] << "\n";
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef SENSITIVITY_H
+#define SENSITIVITY_H
+
+#include "Sweep.h"
+
+// Indices per parameter (in the order of the ranges) and per Stats field
+// summed over the fleet.
+struct SensitivityIndices {
+    std::vector<FieldValues> firstOrder;
+    std::vector<FieldValues> totalOrder;
+    FieldValues mean{};
+    FieldValues variance{};
+    int runs = 0;
+    int cachedRuns = 0;
+};
+
+// Saltelli design: base samples A and B from one scrambled Sobol sequence
+// of twice the parameter count, plus, for every parameter i, A with column
+// i taken from B. First-order indices use the Saltelli (2010) estimator,
+// total-order ones Jansen's. Row j of every matrix shares a seed and common
+// random numbers, so the differences come from the parameters alone. Costs
+// samples * (parameters + 2) runs, all in one parallel batch; with a cache,
+// runs repeated across calls (e.g. growing the sample) are not redone.
+SensitivityIndices sobolIndices(const Scenario& base, const std::vector<ParameterRange>& ranges, int samples,
+                                ResultCache* cache = nullptr,
+                                int threads = std::thread::hardware_concurrency());
+
+void printSensitivity(const SensitivityIndices& indices, const std::vector<ParameterRange>& ranges);
+
+#endif
@@ -0,0 +1,131 @@
+#include "eVTOLSimulation.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Branches run in forked children: the kernel shares the parent's pages
+// copy-on-write, so a branch only pays for the state it actually touches.
+// Each child streams its final stats back through a pipe.
+namespace {
+
+struct StatsRecord {
+    Company company;
+    Stats stats;
+};
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+std::map<Company, Stats> readStats(int fd) {
+    std::vector<char> buffer;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) > 0)
+        buffer.insert(buffer.end(), chunk, chunk + n);
+    if (buffer.size() % sizeof(StatsRecord) != 0)
+        throw std::runtime_error("branch returned malformed stats");
+
+    std::map<Company, Stats> stats;
+    for (size_t off = 0; off < buffer.size(); off += sizeof(StatsRecord)) {
+        StatsRecord r;
+        std::memcpy(&r, buffer.data() + off, sizeof(r));
+        stats[r.company] = r.stats;
+    }
+    return stats;
+}
+
+}
+
+// The parent's own unmodified continuation runs as an extra branch and is
+// the baseline every delta is taken against.
+std::vector<BranchResult> Simulation::branch(const std::vector<Branch>& branches, double horizon) const {
+    struct Child { pid_t pid; int fd; };
+    std::vector<Child> children;
+    std::cout.flush();
+
+    // Closes every pipe still open and waits for every child forked so far,
+    // whatever happened to the others; true if all of them succeeded.
+    auto reap = [&children] {
+        bool ok = true;
+        for (auto& child : children) {
+            if (child.fd >= 0) ::close(child.fd);
+            child.fd = -1;
+            int status = 0;
+            if (::waitpid(child.pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+        }
+        children.clear();
+        return ok;
+    };
+
+    for (size_t i = 0; i <= branches.size(); ++i) {
+        int fds[2];
+        if (::pipe(fds) != 0) {
+            reap();
+            throw std::runtime_error("cannot create branch pipe");
+        }
+        pid_t pid = ::fork();
+        if (pid < 0) {
+            ::close(fds[0]);
+            ::close(fds[1]);
+            reap();
+            throw std::runtime_error("cannot fork branch");
+        }
+        if (pid == 0) {
+            ::close(fds[0]);
+            int status = 0;
+            try {
+                Simulation& sim = const_cast<Simulation&>(*this);
+                if (i > 0 && branches[i - 1].modify) branches[i - 1].modify(sim);
+                sim.runUntil(horizon);
+                for (const auto& [comp, stat] : sim.stats) {
+                    StatsRecord r{comp, stat};
+                    if (!writeAll(fds[1], reinterpret_cast<const char*>(&r), sizeof(r))) status = 1;
+                }
+            } catch (...) {
+                status = 1;
+            }
+            ::close(fds[1]);
+            ::_exit(status);
+        }
+        ::close(fds[1]);
+        children.push_back({pid, fds[0]});
+    }
+
+    std::vector<std::map<Company, Stats>> results;
+    bool failed = false;
+    for (auto& child : children) {
+        try {
+            results.push_back(readStats(child.fd));
+        } catch (const std::runtime_error&) {
+            failed = true;
+        }
+        ::close(child.fd);
+        child.fd = -1;
+    }
+    if (!reap() || failed) throw std::runtime_error("branch simulation failed");
+
+    const auto& baseline = results[0];
+    std::vector<BranchResult> out;
+    for (size_t i = 0; i < branches.size(); ++i) {
+        BranchResult r{branches[i].name, results[i + 1], {}};
+        for (int c = ALPHA; c <= ECHO; ++c) {
+            Company comp = static_cast<Company>(c);
+            auto b = baseline.find(comp);
+            auto s = r.stats.find(comp);
+            if (b == baseline.end() && s == r.stats.end()) continue;
+            r.delta[comp] = (s == r.stats.end() ? Stats() : s->second) -
+                            (b == baseline.end() ? Stats() : b->second);
+        }
+        out.push_back(r);
+    }
+    return out;
+}
@@ -0,0 +1,97 @@
+#include "eVTOLSimulation.h"
+
+#include <stdexcept>
+
+ChargeCurves::ChargeCurves(const std::vector<VehicleType>& types, double knee, double cutoff)
+    : time(types.size() * POINTS), charge(types.size() * POINTS), step(types.size(), 1.0) {
+    if (!(knee > 0 && knee <= 1) || !(cutoff > 0 && cutoff <= 1))
+        throw std::runtime_error("charge curve knee and cutoff must lie in (0, 1]");
+    // Past the knee dS/dt = (1 - a (S - knee)) / T, so
+    //   t(S) = knee T - (T / a) log(1 - a (S - knee)),  a = (1 - cutoff) / (1 - knee).
+    double a = knee < 1 ? (1 - cutoff) / (1 - knee) : 0.0;
+    for (size_t i = 0; i < types.size(); ++i) {
+        double T = types[i].timeToCharge;
+        auto hoursTo = [&](double s) {
+            if (s <= knee || a == 0) return s * T;
+            return knee * T - T / a * std::log(1 - a * (s - knee));
+        };
+        auto chargeAt = [&](double h) {
+            if (h <= knee * T || a == 0) return std::min(h / T, 1.0);
+            return std::min(knee + (1 - std::exp(-a * (h - knee * T) / T)) / a, 1.0);
+        };
+        double full = hoursTo(1.0);
+        size_t base = i * POINTS;
+        step[i] = full / (POINTS - 1);
+        for (int k = 0; k < POINTS; ++k) {
+            time[base + k] = hoursTo(double(k) / (POINTS - 1));
+            charge[base + k] = chargeAt(k * step[i]);
+        }
+        time[base + POINTS - 1] = full;
+        charge[base + POINTS - 1] = 1.0;
+    }
+}
+
+double ChargeCurves::timeTo(int type, double level) const {
+    double hours;
+    timesTo(&type, &level, &hours, 1);
+    return hours;
+}
+
+double ChargeCurves::chargeAfter(int type, double hours) const {
+    double level;
+    chargesAfter(&type, &hours, &level, 1);
+    return level;
+}
+
+void ChargeCurves::timesTo(const int* type, const double* level, double* hours, size_t n) const {
+    const double* table = time.data();
+    for (size_t i = 0; i < n; ++i) {
+        double x = std::min(std::max(level[i], 0.0), 1.0) * (POINTS - 1);
+        int k = std::min(int(x), POINTS - 2);
+        const double* row = table + type[i] * POINTS + k;
+        hours[i] = row[0] + (x - k) * (row[1] - row[0]);
+    }
+}
+
+void ChargeCurves::chargesAfter(const int* type, const double* hours, double* level, size_t n) const {
+    const double* table = charge.data();
+    for (size_t i = 0; i < n; ++i) {
+        double x = std::min(std::max(hours[i] / step[type[i]], 0.0), double(POINTS - 1));
+        int k = std::min(int(x), POINTS - 2);
+        const double* row = table + type[i] * POINTS + k;
+        level[i] = row[0] + (x - k) * (row[1] - row[0]);
+    }
+}
+
+// Sets the CHARGE_END of the chargers just started or, when a queue has
+// just formed or drained, of every occupied charger. A vehicle charges to
+// full unless others are waiting, in which case it leaves at
+// departureCharge, at once if it is already past it. End times come from
+// one batched lookup.
+void Simulation::scheduleCharges(double currentTime, std::vector<size_t> chargers, bool queueChanged) {
+    bool early = !chargingQueue.empty() && scenario.departureCharge < 1;
+    if (queueChanged && scenario.departureCharge < 1) {
+        chargers.clear();
+        for (size_t i = 0; i < activeChargers.size(); ++i)
+            if (activeChargers[i]) chargers.push_back(i);
+    }
+    size_t n = chargers.size();
+    if (n == 0) return;
+
+    std::vector<int> type(n);
+    std::vector<double> level(n, early ? scenario.departureCharge : 1.0), hours(n);
+    for (size_t k = 0; k < n; ++k) type[k] = activeChargers[chargers[k]]->typeIndex;
+    curves.timesTo(type.data(), level.data(), hours.data(), n);
+
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = chargers[k];
+        ChargerPower& p = chargerPower[i];
+        p.target = level[k];
+        cancelChargerEvents(i);
+        Event e{std::max(currentTime, p.start + hours[k]), CHARGE_END};
+        e.vehicleId = activeChargers[i]->id;
+        e.chargerId = i;
+        e.startTime = p.start;
+        pushEvent(e);
+    }
+}
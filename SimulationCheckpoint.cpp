@@ -0,0 +1,322 @@
+#include "eVTOLSimulation.h"
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Snapshot layout: header, then the vehicle types, vehicles, chargers,
+// charging queue (vehicle ids), raw event heap, stats, fault tilts and the
+// textual RNG state. Everything but the RNG is fixed-size records so save and restore are
+// a single linear pass over the state.
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = {'E', 'V', 'T', 'O', 'L', 'C', 'K', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 8;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numTypes;
+    uint32_t numVehicles;
+    uint32_t numChargers;
+    uint32_t queueLength;
+    uint32_t numEvents;
+    uint32_t numStats;
+    uint32_t numTilts;
+    uint32_t rngBytes;
+    uint64_t staleEvents;
+    uint64_t dispatched;
+    double now;
+    double duration;
+    uint32_t seed;
+    uint32_t randomFlags;  // bit 0: common random numbers, bit 1: antithetic faults
+    double logLikelihood;
+    double sitePower;
+    uint32_t powerAllocation;
+    double chargeKnee;
+    double chargeCutoff;
+    double departureCharge;
+};
+
+struct VehicleRecord {
+    VehicleType type;
+    int typeIndex;
+    double nextAvailableTime;
+    long long flights;
+    double charge;
+    unsigned generation;
+    int pending;
+};
+
+struct ChargerRecord {
+    int vehicleId;
+    unsigned generation;
+    int pending;
+    ChargerPower power;
+};
+
+struct StatsRecord {
+    Company company;
+    Stats stats;
+};
+
+struct TiltRecord {
+    Company company;
+    double tilt;
+};
+
+static_assert(std::is_trivially_copyable<Event>::value, "events are checkpointed as raw bytes");
+static_assert(std::is_trivially_copyable<VehicleRecord>::value, "vehicles are checkpointed as raw bytes");
+
+template <typename T>
+void put(char*& out, const T& value) {
+    std::memcpy(out, &value, sizeof(T));
+    out += sizeof(T);
+}
+
+template <typename T>
+T take(const char*& in, const char* end) {
+    if (in + sizeof(T) > end) throw std::runtime_error("checkpoint truncated");
+    T value;
+    std::memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+}
+
+std::string rngState(const std::default_random_engine& rng) {
+    std::ostringstream os;
+    os << rng;
+    return os.str();
+}
+
+}
+
+// Checked here rather than in writeSnapshot so that saveCheckpoint fails
+// before it touches the file.
+size_t Simulation::snapshotSize() const {
+    if (scenario.trackGradients) throw std::runtime_error("gradient tracking state is not checkpointed");
+    return sizeof(SnapshotHeader) +
+           vehicleTypes.size() * sizeof(VehicleType) +
+           vehicles.size() * sizeof(VehicleRecord) +
+           activeChargers.size() * sizeof(ChargerRecord) +
+           chargingQueue.size() * sizeof(int) +
+           eventQueue.size() * sizeof(Event) +
+           stats.size() * sizeof(StatsRecord) +
+           scenario.faultTilt.size() * sizeof(TiltRecord) +
+           rngState(rng).size();
+}
+
+void Simulation::writeSnapshot(char* out) const {
+    std::string rngText = rngState(rng);
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.numTypes = vehicleTypes.size();
+    header.numVehicles = vehicles.size();
+    header.numChargers = activeChargers.size();
+    header.queueLength = chargingQueue.size();
+    header.numEvents = eventQueue.size();
+    header.numStats = stats.size();
+    header.numTilts = scenario.faultTilt.size();
+    header.rngBytes = rngText.size();
+    header.staleEvents = staleEvents;
+    header.dispatched = dispatched;
+    header.now = now;
+    header.duration = scenario.duration;
+    header.seed = scenario.seed;
+    header.randomFlags = scenario.commonRandomNumbers | scenario.antitheticFaults << 1;
+    header.logLikelihood = logLikelihood;
+    header.sitePower = scenario.sitePower;
+    header.powerAllocation = scenario.powerAllocation;
+    header.chargeKnee = scenario.chargeKnee;
+    header.chargeCutoff = scenario.chargeCutoff;
+    header.departureCharge = scenario.departureCharge;
+    put(out, header);
+
+    for (const auto& t : vehicleTypes) put(out, t);
+    for (size_t i = 0; i < vehicles.size(); ++i)
+        put(out, VehicleRecord{vehicles[i]->type, vehicles[i]->typeIndex, vehicles[i]->nextAvailableTime,
+                               vehicles[i]->flights, vehicles[i]->charge, vehicleGeneration[i],
+                               vehiclePending[i]});
+    for (size_t i = 0; i < activeChargers.size(); ++i)
+        put(out, ChargerRecord{activeChargers[i] ? activeChargers[i]->id : -1,
+                               chargerGeneration[i], chargerPending[i], chargerPower[i]});
+    for (const auto& v : chargingQueue) put(out, v->id);
+    std::memcpy(out, eventQueue.data(), eventQueue.size() * sizeof(Event));
+    out += eventQueue.size() * sizeof(Event);
+    for (const auto& [comp, stat] : stats) put(out, StatsRecord{comp, stat});
+    for (const auto& [comp, tilt] : scenario.faultTilt) put(out, TiltRecord{comp, tilt});
+    std::memcpy(out, rngText.data(), rngText.size());
+}
+
+std::vector<char> Simulation::snapshot() const {
+    std::vector<char> buffer(snapshotSize());
+    writeSnapshot(buffer.data());
+    return buffer;
+}
+
+// Everything is parsed and checked into locals first, so a snapshot that
+// is rejected leaves this simulation as it was.
+void Simulation::restore(const char* data, size_t size) {
+    if (scenario.trackGradients) throw std::runtime_error("gradient tracking state is not checkpointed");
+    const char* in = data;
+    const char* end = data + size;
+    auto header = take<SnapshotHeader>(in, end);
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        throw std::runtime_error("not an eVTOL checkpoint");
+    if (header.version != SNAPSHOT_VERSION)
+        throw std::runtime_error("unsupported checkpoint version");
+
+    std::vector<VehicleType> types(header.numTypes);
+    for (auto& t : types) t = take<VehicleType>(in, end);
+
+    std::vector<std::shared_ptr<Vehicle>> fleet;
+    std::vector<unsigned> vehicleGen(header.numVehicles);
+    std::vector<int> vehicleWaits(header.numVehicles);
+    for (uint32_t i = 0; i < header.numVehicles; ++i) {
+        auto r = take<VehicleRecord>(in, end);
+        if (r.typeIndex < 0 || r.typeIndex >= int(header.numTypes))
+            throw std::runtime_error("checkpoint refers to a missing vehicle type");
+        auto v = std::make_shared<Vehicle>(r.type, i, r.typeIndex);
+        v->nextAvailableTime = r.nextAvailableTime;
+        v->flights = r.flights;
+        v->charge = r.charge;
+        fleet.push_back(v);
+        vehicleGen[i] = r.generation;
+        vehicleWaits[i] = r.pending;
+    }
+    auto vehicleAt = [&](int id) {
+        if (id < 0 || id >= int(header.numVehicles))
+            throw std::runtime_error("checkpoint refers to a missing vehicle");
+        return fleet[id];
+    };
+
+    std::vector<std::shared_ptr<Vehicle>> chargers(header.numChargers);
+    std::vector<ChargerPower> power(header.numChargers);
+    std::vector<unsigned> chargerGen(header.numChargers);
+    std::vector<int> chargerWaits(header.numChargers);
+    for (uint32_t i = 0; i < header.numChargers; ++i) {
+        auto r = take<ChargerRecord>(in, end);
+        if (r.vehicleId >= 0) chargers[i] = vehicleAt(r.vehicleId);
+        chargerGen[i] = r.generation;
+        chargerWaits[i] = r.pending;
+        power[i] = r.power;
+    }
+
+    std::deque<std::shared_ptr<Vehicle>> queue;
+    for (uint32_t i = 0; i < header.queueLength; ++i) queue.push_back(vehicleAt(take<int>(in, end)));
+
+    size_t eventBytes = size_t(header.numEvents) * sizeof(Event);
+    if (size_t(end - in) < eventBytes) throw std::runtime_error("checkpoint truncated");
+    std::vector<Event> events(header.numEvents);
+    std::memcpy(events.data(), in, eventBytes);
+    in += eventBytes;
+    for (const Event& e : events)
+        if (e.vehicleId < 0 || e.vehicleId >= int(header.numVehicles) || e.chargerId < -1 ||
+            e.chargerId >= int(header.numChargers) || (e.kind == CHARGE_END && e.chargerId < 0))
+            throw std::runtime_error("checkpoint event refers to a missing vehicle or charger");
+
+    std::map<Company, Stats> totals;
+    for (uint32_t i = 0; i < header.numStats; ++i) {
+        auto r = take<StatsRecord>(in, end);
+        totals[r.company] = r.stats;
+    }
+    std::map<Company, double> tilts;
+    for (uint32_t i = 0; i < header.numTilts; ++i) {
+        auto r = take<TiltRecord>(in, end);
+        tilts[r.company] = r.tilt;
+    }
+
+    if (size_t(end - in) < header.rngBytes) throw std::runtime_error("checkpoint truncated");
+    std::default_random_engine engine;
+    std::istringstream is(std::string(in, header.rngBytes));
+    if (!(is >> engine)) throw std::runtime_error("checkpoint has a malformed random state");
+
+    Scenario restored = scenario;
+    restored.vehicleTypes = types;
+    restored.numVehicles = header.numVehicles;
+    restored.numChargers = header.numChargers;
+    restored.duration = header.duration;
+    restored.seed = header.seed;
+    restored.commonRandomNumbers = header.randomFlags & 1;
+    restored.antitheticFaults = header.randomFlags & 2;
+    restored.faultTilt = std::move(tilts);
+    restored.sitePower = header.sitePower;
+    restored.powerAllocation = PowerAllocation(header.powerAllocation);
+    restored.chargeKnee = header.chargeKnee;
+    restored.chargeCutoff = header.chargeCutoff;
+    restored.departureCharge = header.departureCharge;
+    ChargeCurves restoredCurves;
+    if (restored.chargeKnee < 1 || restored.departureCharge < 1)
+        restoredCurves = ChargeCurves(types, restored.chargeKnee, restored.chargeCutoff);
+
+    // Nothing below can throw.
+    scenario = std::move(restored);
+    vehicleTypes = std::move(types);
+    vehicles = std::move(fleet);
+    vehicleGeneration = std::move(vehicleGen);
+    vehiclePending = std::move(vehicleWaits);
+    activeChargers = std::move(chargers);
+    chargerPower = std::move(power);
+    chargerGeneration = std::move(chargerGen);
+    chargerPending = std::move(chargerWaits);
+    chargingQueue = std::move(queue);
+    eventQueue = std::move(events);
+    stats = std::move(totals);
+    curves = std::move(restoredCurves);
+    rng = engine;
+    staleEvents = header.staleEvents;
+    dispatched = header.dispatched;
+    now = header.now;
+    logLikelihood = header.logLikelihood;
+    queueWaiting = !chargingQueue.empty();
+    checkpointInterval = 0.0;
+    trajectory.clear();
+    checkpoints.clear();
+}
+
+void Simulation::saveCheckpoint(const std::string& path) const {
+    size_t size = snapshotSize();
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("cannot open checkpoint " + path);
+    if (::ftruncate(fd, size) != 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot size checkpoint " + path);
+    }
+    void* map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) throw std::runtime_error("cannot map checkpoint " + path);
+    try {
+        writeSnapshot(static_cast<char*>(map));
+    } catch (...) {
+        ::munmap(map, size);
+        throw;
+    }
+    ::munmap(map, size);
+}
+
+void Simulation::loadCheckpoint(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open checkpoint " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot read checkpoint " + path);
+    }
+    void* map = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) throw std::runtime_error("cannot map checkpoint " + path);
+    try {
+        restore(static_cast<const char*>(map), st.st_size);
+    } catch (...) {
+        ::munmap(map, st.st_size);
+        throw;
+    }
+    ::munmap(map, st.st_size);
+}
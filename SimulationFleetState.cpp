@@ -0,0 +1,127 @@
+#include "eVTOLSimulation.h"
+
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+// Conversions between a detailed simulation and the per-type aggregate
+// state used by the fluid model and the time-parallel driver.
+namespace {
+
+// Rounds a, b, c to integers summing to total, largest remainders first.
+void roundToTotal(double& a, double& b, double& c, int total) {
+    double* parts[3] = {&a, &b, &c};
+    double sum = std::max(a + b + c, 1e-12);
+    double frac[3];
+    int assigned = 0;
+    for (int k = 0; k < 3; ++k) {
+        double scaled = std::max(*parts[k], 0.0) * total / sum;
+        double whole = std::floor(scaled);
+        frac[k] = scaled - whole;
+        *parts[k] = whole;
+        assigned += int(whole);
+    }
+    while (assigned < total) {
+        int best = std::max_element(frac, frac + 3) - frac;
+        *parts[best] += 1;
+        frac[best] = -1;
+        assigned++;
+    }
+}
+
+}
+
+FleetState Simulation::fleetState() const {
+    size_t n = vehicleTypes.size();
+    FleetState s{std::vector<double>(n), std::vector<double>(n), std::vector<double>(n)};
+    for (const auto& v : vehicles) s.flying[v->typeIndex]++;
+    for (const auto& v : activeChargers) {
+        if (!v) continue;
+        size_t i = v->typeIndex;
+        s.flying[i]--;
+        s.charging[i]++;
+    }
+    for (const auto& v : chargingQueue) {
+        size_t i = v->typeIndex;
+        s.flying[i]--;
+        s.queued[i]++;
+    }
+    return s;
+}
+
+// Rebuilds the event state at startTime from aggregate counts. Vehicles in
+// a phase are spread evenly over it, which is the stationary residual-time
+// distribution; stats restart from zero.
+void Simulation::liftFleetState(const FleetState& state, double startTime) {
+    if (scenario.trackGradients) throw std::runtime_error("gradient tracking needs a run from time zero");
+    std::vector<std::vector<std::shared_ptr<Vehicle>>> byType(vehicleTypes.size());
+    for (const auto& v : vehicles) byType[v->typeIndex].push_back(v);
+
+    std::vector<int> flying(byType.size()), queued(byType.size()), charging(byType.size());
+    for (size_t i = 0; i < byType.size(); ++i) {
+        double f = state.flying[i], q = state.queued[i], c = state.charging[i];
+        roundToTotal(f, q, c, byType[i].size());
+        flying[i] = f;
+        queued[i] = q;
+        charging[i] = c;
+    }
+    int excess = std::accumulate(charging.begin(), charging.end(), 0) - int(activeChargers.size());
+    while (excess-- > 0) {
+        size_t i = std::max_element(charging.begin(), charging.end()) - charging.begin();
+        charging[i]--;
+        queued[i]++;
+    }
+
+    for (size_t i = 0; i < vehicles.size(); ++i) cancelVehicleEvents(i);
+    for (size_t i = 0; i < activeChargers.size(); ++i) cancelChargerEvents(i);
+    compactQueue();
+    std::fill(activeChargers.begin(), activeChargers.end(), nullptr);
+    std::fill(chargerPower.begin(), chargerPower.end(), ChargerPower());
+    for (const auto& v : vehicles) v->charge = 1.0;
+    chargingQueue.clear();
+    stats.clear();
+    logLikelihood = 0.0;
+    now = startTime;
+
+    size_t charger = 0;
+    std::vector<std::deque<std::shared_ptr<Vehicle>>> waiting(byType.size());
+    for (size_t i = 0; i < byType.size(); ++i) {
+        auto& list = byType[i];
+        int k = 0;
+        for (int j = 0; j < charging[i]; ++j, ++k) {
+            auto& v = list[k];
+            activeChargers[charger] = v;
+            if (scenario.sitePower > 0) {
+                double done = 1 - (j + 0.5) / charging[i];
+                chargerPower[charger++] = {v->type.batteryCapacity * (1 - done), 0.0, startTime,
+                                           startTime - done * v->type.timeToCharge};
+                continue;
+            }
+            double duration = stateOfCharge() ? curves.timeTo(v->typeIndex, 1.0) : v->type.timeToCharge;
+            Event e{startTime + (j + 0.5) / charging[i] * duration, CHARGE_END};
+            e.vehicleId = v->id;
+            e.chargerId = charger;
+            chargerPower[charger++].start = e.time - duration;
+            pushEvent(e);
+        }
+        for (int j = 0; j < queued[i]; ++j, ++k) waiting[i].push_back(list[k]);
+        for (int j = 0; j < flying[i]; ++j, ++k) {
+            auto& v = list[k];
+            double duration = v->getFlightDuration();
+            scheduleFlight(v, startTime + (j + 0.5) / flying[i] * duration - duration);
+        }
+    }
+
+    // Interleave the types in the queue rather than lining them up by type.
+    for (bool more = true; more;) {
+        more = false;
+        for (auto& w : waiting) {
+            if (w.empty()) continue;
+            chargingQueue.push_back(w.front());
+            w.pop_front();
+            more = true;
+        }
+    }
+    queueWaiting = !chargingQueue.empty();
+    tryCharging(startTime);
+}
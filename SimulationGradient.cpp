@@ -0,0 +1,113 @@
+#include "eVTOLSimulation.h"
+
+// Infinitesimal perturbation analysis: every event time carries its
+// derivative with respect to the Gradient parameters. A flight ends its
+// duration B / (S E) after it starts; a charge ends timeToCharge after it
+// starts; a charge starts at the event that made it possible (the arrival
+// or the previous charge ending), so it inherits that event's derivative.
+// Where two events coincide at the nominal parameters (e.g. arrivals of
+// different types at the same instant) the path is not differentiable and
+// this gives the derivative that keeps the current order.
+namespace {
+
+Gradient flightDurationGrad(const VehicleType& t) {
+    Gradient g{};
+    double d = t.batteryCapacity / (t.cruiseSpeed * t.energyPerMile);
+    g[gradientIndex(t.company, D_CRUISE_SPEED)] = -d / t.cruiseSpeed;
+    g[gradientIndex(t.company, D_BATTERY_CAPACITY)] = d / t.batteryCapacity;
+    return g;
+}
+
+Gradient plus(Gradient a, const Gradient& b) {
+    for (size_t k = 0; k < a.size(); ++k) a[k] += b[k];
+    return a;
+}
+
+Gradient minus(Gradient a, const Gradient& b) {
+    for (size_t k = 0; k < a.size(); ++k) a[k] -= b[k];
+    return a;
+}
+
+// Adds tau hours of flight, whose derivative is dtau, at the type's rates:
+// distance S, passenger-miles P S and expected faults p per hour.
+void accrueFlight(CompanyGradient& g, const VehicleType& t, double tau, const Gradient& dtau) {
+    size_t speed = gradientIndex(t.company, D_CRUISE_SPEED);
+    g.accrued.totalFlightTime += tau;
+    g.accrued.totalDistance += t.cruiseSpeed * tau;
+    g.accrued.passengerMiles += t.passengerCount * t.cruiseSpeed * tau;
+    g.accrued.expectedFaults += t.faultProbPerHour * tau;
+    for (size_t k = 0; k < dtau.size(); ++k) {
+        g.flightTime[k] += dtau[k];
+        g.distance[k] += t.cruiseSpeed * dtau[k];
+        g.passengerMiles[k] += t.passengerCount * t.cruiseSpeed * dtau[k];
+        g.expectedFaults[k] += t.faultProbPerHour * dtau[k];
+    }
+    g.distance[speed] += tau;
+    g.passengerMiles[speed] += t.passengerCount * tau;
+}
+
+void accrueCharge(CompanyGradient& g, double tau, const Gradient& dtau) {
+    g.accrued.totalChargeTime += tau;
+    for (size_t k = 0; k < dtau.size(); ++k) g.chargeTime[k] += dtau[k];
+}
+
+}
+
+void Simulation::gradientFlightStart(const Vehicle& v, double startTime) {
+    VehicleGradient& g = vehicleGradients[v.id];
+    g.phase = FLYING;
+    g.start = startTime;
+    g.startGrad = nowGrad;
+    g.endGrad = plus(nowGrad, flightDurationGrad(v.type));
+}
+
+void Simulation::gradientFlightEnd(const Vehicle& v, double duration, bool fault) {
+    VehicleGradient& g = vehicleGradients[v.id];
+    CompanyGradient& c = completedGradients[v.type.company];
+    accrueFlight(c, v.type, duration, minus(g.endGrad, g.startGrad));
+
+    double p = v.type.faultProbPerHour;
+    double q = std::min(p * duration, 1.0);
+    if (p > 0 && q < 1) c.faultScore += fault ? 1 / p : -duration / (1 - q);
+
+    g.phase = QUEUED;
+    g.start = now;
+    g.startGrad = nowGrad;
+}
+
+void Simulation::gradientChargeStart(const Vehicle& v, double startTime) {
+    VehicleGradient& g = vehicleGradients[v.id];
+    g.phase = CHARGING;
+    g.start = startTime;
+    g.startGrad = nowGrad;
+    g.endGrad = nowGrad;
+    g.endGrad[gradientIndex(v.type.company, D_TIME_TO_CHARGE)] += 1;
+}
+
+void Simulation::gradientChargeEnd(const Vehicle& v) {
+    const VehicleGradient& g = vehicleGradients[v.id];
+    accrueCharge(completedGradients[v.type.company], v.type.timeToCharge, minus(g.endGrad, g.startGrad));
+}
+
+// Completed activity plus the elapsed part of what is in progress now; the
+// horizon itself does not depend on the parameters.
+std::map<Company, CompanyGradient> Simulation::gradients() const {
+    std::map<Company, CompanyGradient> result = completedGradients;
+    for (const auto& v : vehicles) {
+        if (vehicleGradients.empty()) break;
+        const VehicleGradient& g = vehicleGradients[v->id];
+        CompanyGradient& c = result[v->type.company];
+        Gradient elapsed = minus(Gradient{}, g.startGrad);
+        if (g.phase == FLYING && now > g.start) accrueFlight(c, v->type, now - g.start, elapsed);
+        if (g.phase == CHARGING && now > g.start) accrueCharge(c, now - g.start, elapsed);
+    }
+    for (auto& [comp, c] : result) {
+        auto it = stats.find(comp);
+        if (it == stats.end()) continue;
+        c.accrued.totalFlights = it->second.totalFlights;
+        c.accrued.totalCharges = it->second.totalCharges;
+        c.accrued.totalFaults = it->second.totalFaults;
+        c.faultDerivative = it->second.totalFaults * c.faultScore;
+    }
+    return result;
+}
@@ -0,0 +1,91 @@
+#include "eVTOLSimulation.h"
+
+#include <limits>
+
+// While recording, the run keeps in-memory checkpoints at least
+// checkpointInterval apart plus a log of charge starts and queue build-ups.
+// A neighbouring scenario that differs only in charger count or in some
+// types' timeToCharge follows the same trajectory until the first logged
+// point it would react to, so it can resume from the checkpoint before that.
+// Only a log that starts at the first event covers the whole prefix: one
+// started mid-run misses a backlog that was already queued, so resimulate
+// then runs the modified scenario from scratch.
+void Simulation::recordTrajectory(double interval) {
+    checkpointInterval = interval;
+    trajectory.clear();
+    checkpoints.clear();
+    queueWaiting = !chargingQueue.empty();
+    takeTrajectoryCheckpoint();
+}
+
+void Simulation::takeTrajectoryCheckpoint() {
+    checkpoints.push_back({dispatched, now, snapshot()});
+    double upcoming = eventQueue.empty() ? now : eventQueue.front().time;
+    nextCheckpoint = upcoming + checkpointInterval;
+}
+
+void Simulation::resizeChargers(size_t count) {
+    while (activeChargers.size() > count) {
+        activeChargers.pop_back();
+        chargerPower.pop_back();
+        chargerGeneration.pop_back();
+        chargerPending.pop_back();
+    }
+    while (activeChargers.size() < count)
+        addCharger();
+}
+
+Simulation Simulation::resimulate(const Scenario& modified) const {
+    Simulation sim(modified);
+    if (checkpoints.empty() || checkpoints.front().event != 0 || modified.seed != scenario.seed ||
+        modified.numVehicles != scenario.numVehicles || modified.fleetMix != scenario.fleetMix ||
+        modified.sitePower != scenario.sitePower || modified.powerAllocation != scenario.powerAllocation ||
+        modified.chargeKnee != scenario.chargeKnee || modified.chargeCutoff != scenario.chargeCutoff ||
+        modified.departureCharge != scenario.departureCharge ||
+        modified.commonRandomNumbers != scenario.commonRandomNumbers ||
+        modified.antitheticFaults != scenario.antitheticFaults || modified.faultTilt != scenario.faultTilt ||
+        modified.trackGradients != scenario.trackGradients ||
+        modified.vehicleTypes.size() != scenario.vehicleTypes.size())
+        return sim;
+
+    std::vector<int> chargeTimeChanged;
+    for (size_t i = 0; i < scenario.vehicleTypes.size(); ++i) {
+        const VehicleType& a = scenario.vehicleTypes[i];
+        const VehicleType& b = modified.vehicleTypes[i];
+        if (a.company != b.company || a.cruiseSpeed != b.cruiseSpeed ||
+            a.batteryCapacity != b.batteryCapacity || a.energyPerMile != b.energyPerMile ||
+            a.passengerCount != b.passengerCount || a.faultProbPerHour != b.faultProbPerHour)
+            return sim;
+        if (a.timeToCharge != b.timeToCharge)
+            chargeTimeChanged.push_back(i);
+    }
+
+    uint64_t divergence = std::numeric_limits<uint64_t>::max();
+    for (const auto& t : trajectory) {
+        bool affected = t.kind == QUEUE_WAIT
+            ? modified.numChargers > scenario.numChargers
+            : t.charger >= modified.numChargers ||
+              std::find(chargeTimeChanged.begin(), chargeTimeChanged.end(), t.type) != chargeTimeChanged.end();
+        if (affected) {
+            divergence = t.event;
+            break;
+        }
+    }
+
+    auto cp = std::upper_bound(checkpoints.begin(), checkpoints.end(), divergence,
+                               [](uint64_t event, const TrajectoryCheckpoint& c) { return event < c.event; });
+    if (cp == checkpoints.begin()) return sim;
+    --cp;
+
+    // Before the divergence no vehicle of a changed type is charging, no
+    // charger past the new count is occupied and nobody is queued, so the
+    // changes can be applied directly to the restored state.
+    sim.restore(cp->state.data(), cp->state.size());
+    sim.resizeChargers(modified.numChargers);
+    for (size_t i = 0; i < modified.vehicleTypes.size(); ++i)
+        sim.vehicleTypes[i].timeToCharge = modified.vehicleTypes[i].timeToCharge;
+    for (const auto& v : sim.vehicles) v->type.timeToCharge = modified.vehicleTypes[v->typeIndex].timeToCharge;
+    sim.scenario = modified;
+    if (sim.stateOfCharge()) sim.curves = ChargeCurves(sim.vehicleTypes, modified.chargeKnee, modified.chargeCutoff);
+    return sim;
+}
@@ -0,0 +1,109 @@
+#include "Sobol.h"
+#include "eVTOLSimulation.h"
+
+namespace {
+
+int degree(uint32_t poly) {
+    int d = -1;
+    for (; poly; poly >>= 1) d++;
+    return d;
+}
+
+uint32_t mulMod(uint32_t a, uint32_t b, uint32_t poly) {
+    int n = degree(poly);
+    uint32_t r = 0;
+    for (; b; b >>= 1) {
+        if (b & 1) r ^= a;
+        a <<= 1;
+        if (a >> n & 1) a ^= poly;
+    }
+    return r;
+}
+
+uint32_t powMod(uint32_t base, uint64_t e, uint32_t poly) {
+    uint32_t r = 1;
+    for (; e; e >>= 1, base = mulMod(base, base, poly))
+        if (e & 1) r = mulMod(r, base, poly);
+    return r;
+}
+
+// x generates the multiplicative group of GF(2)[x] / poly, whose order is
+// 2^n - 1, exactly when poly is primitive.
+bool primitive(uint32_t poly) {
+    int n = degree(poly);
+    if (n == 1) return poly == 3;
+    uint64_t order = (uint64_t(1) << n) - 1;
+    if (powMod(2, order, poly) != 1) return false;
+    uint64_t rest = order;
+    for (uint64_t p = 2; p * p <= rest; ++p) {
+        if (rest % p) continue;
+        if (powMod(2, order / p, poly) == 1) return false;
+        while (rest % p == 0) rest /= p;
+    }
+    return rest == 1 || powMod(2, order / rest, poly) != 1;
+}
+
+std::vector<uint32_t> primitivePolynomials(int count) {
+    std::vector<uint32_t> polys;
+    for (uint32_t poly = 3; int(polys.size()) < count; poly += 2)
+        if (primitive(poly)) polys.push_back(poly);
+    return polys;
+}
+
+uint32_t parity(uint32_t x) { return __builtin_parity(x); }
+
+}
+
+SobolSequence::SobolSequence(int dimensions) : directions(dimensions), shift(dimensions) {
+    std::vector<uint32_t> polys = primitivePolynomials(std::max(dimensions - 1, 0));
+    for (int d = 0; d < dimensions; ++d) {
+        auto& v = directions[d];
+        v.resize(BITS);
+        if (d == 0) {
+            for (int k = 0; k < BITS; ++k) v[k] = uint32_t(1) << (BITS - 1 - k);
+            continue;
+        }
+        uint32_t poly = polys[d - 1];
+        int s = degree(poly);
+        for (int k = 0; k < s && k < BITS; ++k) {
+            uint32_t m = uint32_t(counterUniform(d, k, 0) * (2u << k)) | 1;
+            v[k] = m << (BITS - 1 - k);
+        }
+        for (int k = s; k < BITS; ++k) {
+            v[k] = v[k - s] ^ (v[k - s] >> s);
+            for (int j = 1; j < s; ++j)
+                if (poly >> (s - j) & 1) v[k] ^= v[k - j];
+        }
+    }
+}
+
+// The scramble is linear, so it is applied to the direction numbers once:
+// L (v_1 xor v_2 ...) = L v_1 xor L v_2 ...
+SobolSequence::SobolSequence(int dimensions, unsigned scrambleSeed) : SobolSequence(dimensions) {
+    for (int d = 0; d < dimensions; ++d) {
+        uint64_t stream = uint64_t(d) * (BITS + 1);
+        std::vector<uint32_t> rows(BITS);
+        for (int k = 0; k < BITS; ++k) {
+            uint32_t top = uint32_t(1) << (BITS - 1 - k);
+            uint32_t above = ~(top | (top - 1));
+            rows[k] = top | (uint32_t(counterUniform(scrambleSeed, stream + k, 0) * 4294967296.0) & above);
+        }
+        for (auto& v : directions[d]) {
+            uint32_t y = 0;
+            for (int k = 0; k < BITS; ++k) y |= parity(rows[k] & v) << (BITS - 1 - k);
+            v = y;
+        }
+        shift[d] = uint32_t(counterUniform(scrambleSeed, stream + BITS, 0) * 4294967296.0);
+    }
+}
+
+std::vector<double> SobolSequence::point(uint32_t index) const {
+    std::vector<double> x(directions.size());
+    for (size_t d = 0; d < directions.size(); ++d) {
+        uint32_t bits = shift[d];
+        for (int k = 0; index >> k; ++k)
+            if (index >> k & 1) bits ^= directions[d][k];
+        x[d] = bits * 0x1.0p-32;
+    }
+    return x;
+}
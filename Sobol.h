@@ -0,0 +1,28 @@
+#ifndef SOBOL_H
+#define SOBOL_H
+
+#include <cstdint>
+#include <vector>
+
+// Sobol low-discrepancy points in [0, 1)^dimensions. Dimension 0 is the
+// van der Corput sequence; dimension d uses the d-th primitive polynomial
+// over GF(2) in order of degree, with odd initial direction numbers drawn
+// from a fixed stream. The scrambled form applies a random lower-triangular
+// linear matrix scramble and a random digital shift per dimension, which
+// keeps the net structure, makes every point uniform, and lets independent
+// scrambles give an error estimate.
+class SobolSequence {
+public:
+    static constexpr int BITS = 32;
+
+    explicit SobolSequence(int dimensions);
+    SobolSequence(int dimensions, unsigned scrambleSeed);
+    int dimensions() const { return directions.size(); }
+    std::vector<double> point(uint32_t index) const;
+
+private:
+    std::vector<std::vector<uint32_t>> directions;  // [dimension][bit]
+    std::vector<uint32_t> shift;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include "Surrogate.h"
+
+#include <cmath>
+#include <set>
+
+namespace {
+
+// In-place Cholesky factorisation of a symmetric positive-definite n x n
+// matrix; false if it is not numerically positive definite.
+bool cholesky(std::vector<double>& a, size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        double d = a[j * n + j];
+        for (size_t k = 0; k < j; ++k) d -= a[j * n + k] * a[j * n + k];
+        if (d <= 0) return false;
+        d = std::sqrt(d);
+        a[j * n + j] = d;
+        for (size_t i = j + 1; i < n; ++i) {
+            double s = a[i * n + j];
+            for (size_t k = 0; k < j; ++k) s -= a[i * n + k] * a[j * n + k];
+            a[i * n + j] = s / d;
+        }
+        for (size_t k = j + 1; k < n; ++k) a[j * n + k] = 0;
+    }
+    return true;
+}
+
+// Solves L x = b in place.
+void forward(const std::vector<double>& l, size_t n, std::vector<double>& b) {
+    for (size_t i = 0; i < n; ++i) {
+        double s = b[i];
+        for (size_t k = 0; k < i; ++k) s -= l[i * n + k] * b[k];
+        b[i] = s / l[i * n + i];
+    }
+}
+
+// Solves L^T x = b in place.
+void backward(const std::vector<double>& l, size_t n, std::vector<double>& b) {
+    for (size_t i = n; i-- > 0;) {
+        double s = b[i];
+        for (size_t k = i + 1; k < n; ++k) s -= l[k * n + i] * b[k];
+        b[i] = s / l[i * n + i];
+    }
+}
+
+}
+
+StatsTable Prediction::stats() const {
+    StatsTable table;
+    for (const auto& [comp, m] : mean) {
+        Stats& s = table[comp];
+        s.totalFlightTime = m[FLIGHT_TIME];
+        s.totalDistance = m[DISTANCE];
+        s.totalChargeTime = m[CHARGE_TIME];
+        s.passengerMiles = m[PASSENGER_MILES];
+        s.totalFlights = std::llround(m[FLIGHTS]);
+        s.totalCharges = std::llround(m[CHARGES]);
+        s.totalFaults = std::llround(m[FAULTS]);
+        s.expectedFaults = m[FAULTS];
+    }
+    return table;
+}
+
+Surrogate::Surrogate(std::vector<ParameterRange> ranges) : ranges(std::move(ranges)) {}
+
+std::vector<double> Surrogate::position(const Scenario& scenario) const {
+    std::vector<double> x;
+    for (const auto& r : ranges) x.push_back(parameterPosition(scenario, r));
+    return x;
+}
+
+double Surrogate::kernel(const std::vector<double>& a, const std::vector<double>& b, double length) const {
+    double d2 = 0;
+    for (size_t k = 0; k < a.size(); ++k) d2 += (a[k] - b[k]) * (a[k] - b[k]);
+    return std::exp(-d2 / (2 * length * length));
+}
+
+void Surrogate::add(const Scenario& scenario, const StatsTable& stats) {
+    inputs.push_back(position(scenario));
+    std::map<Company, FieldValues> y;
+    for (const auto& t : scenario.vehicleTypes) y[t.company] = FieldValues{};
+    for (const auto& [comp, s] : stats)
+        for (int f = 0; f < NUM_STATS_FIELDS; ++f) y[comp][f] = statsField(s, StatsField(f));
+    outputs.push_back(std::move(y));
+    fitted = false;
+}
+
+void Surrogate::add(const ResultCache& cache) {
+    for (const auto& [scenario, stats] : cache.entries()) add(scenario, stats);
+}
+
+// Outputs are standardised, then the kernel length scale and noise level
+// maximising the summed log marginal likelihood are kept.
+void Surrogate::fit() {
+    size_t n = inputs.size();
+    std::set<Company> seen;
+    for (const auto& y : outputs)
+        for (const auto& [comp, v] : y) seen.insert(comp);
+    companies.assign(seen.begin(), seen.end());
+
+    offset.assign(companies.size(), FieldValues{});
+    scale.assign(companies.size(), FieldValues{});
+    std::vector<std::vector<double>> targets;
+    for (size_t c = 0; c < companies.size(); ++c) {
+        for (int f = 0; f < NUM_STATS_FIELDS; ++f) {
+            RunningMoments m;
+            std::vector<double> y(n);
+            for (size_t i = 0; i < n; ++i) {
+                auto it = outputs[i].find(companies[c]);
+                y[i] = it == outputs[i].end() ? 0 : it->second[f];
+                m.add(y[i]);
+            }
+            offset[c][f] = m.mean;
+            scale[c][f] = std::sqrt(m.variance());
+            for (double& v : y) v = scale[c][f] > 0 ? (v - m.mean) / scale[c][f] : 0;
+            targets.push_back(std::move(y));
+        }
+    }
+
+    double best = -INFINITY;
+    for (double length : {0.05, 0.1, 0.2, 0.3, 0.5, 0.8, 1.2, 2.0}) {
+        for (double nugget : {1e-4, 1e-3, 1e-2, 1e-1, 0.3}) {
+            std::vector<double> l(n * n);
+            for (size_t i = 0; i < n; ++i)
+                for (size_t j = 0; j <= i; ++j)
+                    l[i * n + j] = l[j * n + i] = kernel(inputs[i], inputs[j], length) + (i == j ? nugget : 0);
+            if (!cholesky(l, n)) continue;
+            double logDet = 0;
+            for (size_t i = 0; i < n; ++i) logDet += 2 * std::log(l[i * n + i]);
+
+            double likelihood = 0;
+            std::vector<std::vector<double>> a;
+            for (const auto& y : targets) {
+                std::vector<double> z = y;
+                forward(l, n, z);
+                double fitTerm = 0;
+                for (double v : z) fitTerm += v * v;
+                likelihood += -0.5 * fitTerm - 0.5 * logDet;
+                backward(l, n, z);
+                a.push_back(std::move(z));
+            }
+            if (likelihood > best) {
+                best = likelihood;
+                lengthScale = length;
+                noise = nugget;
+                chol = std::move(l);
+                alpha = std::move(a);
+            }
+        }
+    }
+    fitted = !chol.empty();
+}
+
+// Mean k^T alpha; variance k(x, x) - |L^-1 k|^2 of the latent function,
+// both rescaled to the output's units.
+Prediction Surrogate::predict(const Scenario& scenario) const {
+    Prediction p;
+    if (!fitted) return p;
+    size_t n = inputs.size();
+    std::vector<double> x = position(scenario), k(n);
+    for (size_t i = 0; i < n; ++i) k[i] = kernel(x, inputs[i], lengthScale);
+    std::vector<double> v = k;
+    forward(chol, n, v);
+    double latent = 1;
+    for (double e : v) latent -= e * e;
+    double sd = std::sqrt(std::max(latent, 0.0));
+
+    for (size_t c = 0; c < companies.size(); ++c) {
+        FieldValues& mean = p.mean[companies[c]];
+        FieldValues& stddev = p.stddev[companies[c]];
+        for (int f = 0; f < NUM_STATS_FIELDS; ++f) {
+            const std::vector<double>& a = alpha[c * NUM_STATS_FIELDS + f];
+            double m = 0;
+            for (size_t i = 0; i < n; ++i) m += k[i] * a[i];
+            mean[f] = offset[c][f] + scale[c][f] * m;
+            stddev[f] = scale[c][f] * sd;
+        }
+    }
+    return p;
+}
+
+Prediction Surrogate::query(const Scenario& scenario, const SurrogatePolicy& policy) {
+    if (!fitted && !inputs.empty()) fit();
+    Prediction p = predict(scenario);
+    bool confident = fitted;
+    for (const auto& [comp, mean] : p.mean)
+        for (StatsField f : policy.fields)
+            if (p.stddev[comp][f] > policy.maxRelativeError * std::abs(mean[f])) confident = false;
+    if (confident) return p;
+
+    Prediction sim;
+    sim.simulated = true;
+    std::vector<StatsTable> runs = runReplications(scenario, policy.replications, policy.threads, 0, policy.cache);
+    for (const auto& stats : runs) {
+        add(scenario, stats);
+        for (const auto& [comp, y] : outputs.back()) {
+            sim.stddev[comp] = FieldValues{};
+            for (int f = 0; f < NUM_STATS_FIELDS; ++f) sim.mean[comp][f] += y[f] / runs.size();
+        }
+    }
+    fit();
+    return sim;
+}
@@ -0,0 +1,57 @@
+#ifndef SURROGATE_H
+#define SURROGATE_H
+
+#include "Sweep.h"
+
+struct Prediction {
+    std::map<Company, FieldValues> mean;
+    std::map<Company, FieldValues> stddev;  // of the predicted mean, not of a single run
+    bool simulated = false;
+    StatsTable stats() const;
+};
+
+struct SurrogatePolicy {
+    double maxRelativeError = 0.05;         // stddev over |mean| beyond which to simulate
+    std::vector<StatsField> fields = {PASSENGER_MILES};
+    int replications = 4;
+    int threads = std::thread::hardware_concurrency();
+    ResultCache* cache = nullptr;           // consulted before simulating
+};
+
+// Gaussian-process regression of per-company Stats over the positions of
+// the given parameter ranges (each scaled to [0, 1]). Every output shares
+// one squared-exponential kernel and noise level, chosen on a grid by
+// marginal likelihood, so a fit is one Cholesky factorisation and a
+// prediction costs O(n) per output for the mean and O(n^2) once for the
+// variance. Run-to-run noise (different seeds at the same configuration)
+// is absorbed by the noise term.
+class Surrogate {
+public:
+    explicit Surrogate(std::vector<ParameterRange> ranges);
+    void add(const Scenario& scenario, const StatsTable& stats);
+    void add(const ResultCache& cache);
+    void fit();
+    size_t size() const { return inputs.size(); }
+    Prediction predict(const Scenario& scenario) const;
+    // Predicts, or simulates when any checked field is too uncertain; a
+    // simulated answer is added to the training data and refitted.
+    Prediction query(const Scenario& scenario, const SurrogatePolicy& policy = SurrogatePolicy());
+
+private:
+    double kernel(const std::vector<double>& a, const std::vector<double>& b, double lengthScale) const;
+    std::vector<double> position(const Scenario& scenario) const;
+
+    std::vector<ParameterRange> ranges;
+    std::vector<std::vector<double>> inputs;
+    std::vector<std::map<Company, FieldValues>> outputs;
+
+    std::vector<Company> companies;
+    double lengthScale = 0.3;
+    double noise = 1e-2;
+    std::vector<double> chol;               // lower-triangular, row-major n x n
+    std::vector<FieldValues> offset, scale; // per company
+    std::vector<std::vector<double>> alpha; // per company * field
+    bool fitted = false;
+};
+
+#endif
@@ -0,0 +1,393 @@
+#include "Sweep.h"
+#include "FluidModel.h"
+
+#include <cmath>
+#include <numeric>
+
+const std::vector<std::string> parameterNames = {
+    "cruise speed", "battery capacity", "time to charge", "energy per mile", "passenger count",
+    "fault probability", "chargers", "vehicles"
+};
+
+double totalPassengerMiles(const Scenario&, const StatsTable& stats) {
+    double total = 0;
+    for (const auto& [comp, stat] : stats) total += stat.passengerMiles;
+    return total;
+}
+
+Objective netPassengerMiles(double milesPerCharger) {
+    return [milesPerCharger](const Scenario& scenario, const StatsTable& stats) {
+        return totalPassengerMiles(scenario, stats) - milesPerCharger * scenario.numChargers;
+    };
+}
+
+namespace {
+
+double mean(const std::vector<double>& xs) {
+    return xs.empty() ? 0.0 : std::accumulate(xs.begin(), xs.end(), 0.0) / xs.size();
+}
+
+// Longest first cycle, a full flight then a full charge, of any type. Every
+// run starts with the whole fleet taking off at once, so until then the
+// chargers have barely been used.
+double cycleTime(const Scenario& scenario) {
+    double cycle = 0;
+    for (const auto& t : scenario.vehicleTypes)
+        cycle = std::max(cycle, t.batteryCapacity / (t.cruiseSpeed * t.energyPerMile) + t.timeToCharge);
+    return cycle;
+}
+
+std::vector<double> simulate(const Scenario& scenario, int replications, const Objective& objective, int threads,
+                             ResultCache* cache) {
+    std::vector<double> samples;
+    for (const auto& stats : runReplications(scenario, replications, threads, 0, cache))
+        samples.push_back(objective(scenario, stats));
+    return samples;
+}
+
+// Runs `replications` of the scenario through the cold-start `warmup` and a
+// further `window` hours, and scores each run with its totals extrapolated
+// to the full horizon at the rate measured over the window. The transient
+// is counted once, as in a full run, instead of being scaled up with the
+// rest. Both horizons of a replication share its seed, so the shorter run
+// is an exact prefix of the longer one.
+std::vector<double> pilot(const Scenario& scenario, double warmup, double window, int replications,
+                          const Objective& objective, int threads, ResultCache* cache) {
+    if (warmup + window >= scenario.duration) return simulate(scenario, replications, objective, threads, cache);
+    std::vector<Scenario> runs;
+    for (int r = 0; r < replications; ++r) {
+        for (double horizon : {warmup, warmup + window}) {
+            runs.push_back(scenario);
+            runs.back().seed = replicationSeed(scenario.seed, r);
+            runs.back().duration = horizon;
+        }
+    }
+    std::vector<StatsTable> results = runBatch(runs, threads, cache);
+
+    double k = (scenario.duration - warmup - window) / window;
+    std::vector<double> samples;
+    for (int r = 0; r < replications; ++r) {
+        const StatsTable& start = results[2 * r];
+        StatsTable stats = results[2 * r + 1];
+        for (auto& [comp, s] : stats) {
+            auto it = start.find(comp);
+            Stats d = s - (it == start.end() ? Stats() : it->second);
+            s.totalFlightTime += k * d.totalFlightTime;
+            s.totalDistance += k * d.totalDistance;
+            s.totalChargeTime += k * d.totalChargeTime;
+            s.passengerMiles += k * d.passengerMiles;
+            s.totalFlights += std::llround(k * d.totalFlights);
+            s.totalCharges += std::llround(k * d.totalCharges);
+            s.totalFaults += std::llround(k * d.totalFaults);
+            s.expectedFaults += k * d.expectedFaults;
+        }
+        samples.push_back(objective(scenario, stats));
+    }
+    return samples;
+}
+
+double variance(const std::vector<double>& xs) {
+    if (xs.size() < 2) return 0.0;
+    double m = mean(xs), ss = 0;
+    for (double x : xs) ss += (x - m) * (x - m);
+    return ss / (xs.size() - 1);
+}
+
+double normalCdf(double x) { return 0.5 * std::erfc(-x / std::sqrt(2.0)); }
+
+// Variance floor so that a point with identical samples (or a tie with the
+// best) still gets a finite share.
+double noiseFloor(const std::vector<SweepPoint>& points) {
+    double scale = 0;
+    for (const auto& p : points) scale = std::max(scale, std::abs(p.score));
+    return std::max(scale * 1e-9, 1e-12);
+}
+
+size_t bestIndex(const std::vector<SweepPoint>& points) {
+    size_t b = 0;
+    for (size_t i = 1; i < points.size(); ++i)
+        if (points[i].score > points[b].score) b = i;
+    return b;
+}
+
+// Fraction of the budget each point should have under the OCBA ratios.
+std::vector<double> ocbaShares(const std::vector<SweepPoint>& points) {
+    size_t b = bestIndex(points);
+    double eps = noiseFloor(points);
+    std::vector<double> share(points.size());
+    double sumSq = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (i == b) continue;
+        double s = std::sqrt(std::max(variance(points[i].samples), eps * eps));
+        double d = std::max(points[b].score - points[i].score, eps);
+        share[i] = (s / d) * (s / d);
+        sumSq += share[i] * share[i] / (s * s);
+    }
+    double sb = std::sqrt(std::max(variance(points[b].samples), eps * eps));
+    share[b] = sb * std::sqrt(sumSq);
+    if (points.size() == 1) share[b] = 1;
+    double total = std::accumulate(share.begin(), share.end(), 0.0);
+    for (double& x : share) x /= total;
+    return share;
+}
+
+double probabilityCorrect(const std::vector<SweepPoint>& points) {
+    size_t b = bestIndex(points);
+    double eps = noiseFloor(points);
+    double vb = std::max(variance(points[b].samples), eps * eps) / points[b].replications;
+    double miss = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        if (i == b) continue;
+        double vi = std::max(variance(points[i].samples), eps * eps) / points[i].replications;
+        miss += normalCdf(-(points[b].score - points[i].score) / std::sqrt(vb + vi));
+    }
+    return std::max(0.0, 1 - miss);
+}
+
+// Splits `count` new replications between points in proportion to how far
+// each is below its target, largest remainders first.
+std::vector<int> allocate(const std::vector<SweepPoint>& points, const std::vector<double>& share, int count) {
+    int total = count;
+    for (const auto& p : points) total += p.replications;
+    std::vector<double> deficit(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+        deficit[i] = std::max(share[i] * total - points[i].replications, 0.0);
+    double sum = std::accumulate(deficit.begin(), deficit.end(), 0.0);
+    if (sum <= 0) deficit = share, sum = 1;
+
+    std::vector<int> extra(points.size());
+    std::vector<double> frac(points.size());
+    int assigned = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        double scaled = deficit[i] * count / sum;
+        extra[i] = int(scaled);
+        frac[i] = scaled - extra[i];
+        assigned += extra[i];
+    }
+    for (; assigned < count; ++assigned) {
+        size_t i = std::max_element(frac.begin(), frac.end()) - frac.begin();
+        extra[i]++;
+        frac[i] = -1;
+    }
+    return extra;
+}
+
+// Runs `extra[i]` further replications of every point, all in one batch,
+// continuing each point's replication sequence.
+void extend(std::vector<SweepPoint>& points, const std::vector<int>& extra, const Objective& objective,
+            int threads, ResultCache* cache) {
+    std::vector<Scenario> runs;
+    std::vector<size_t> owner;
+    for (size_t i = 0; i < points.size(); ++i) {
+        for (int r = 0; r < extra[i]; ++r) {
+            runs.push_back(points[i].scenario);
+            runs.back().seed = replicationSeed(points[i].scenario.seed, points[i].replications + r);
+            owner.push_back(i);
+        }
+    }
+    std::vector<StatsTable> results = runBatch(runs, threads, cache);
+    for (size_t j = 0; j < results.size(); ++j)
+        points[owner[j]].samples.push_back(objective(points[owner[j]].scenario, results[j]));
+    for (size_t i = 0; i < points.size(); ++i) {
+        points[i].replications += extra[i];
+        points[i].score = mean(points[i].samples);
+    }
+}
+
+// Keeps the best `keep` of the given indices by the given score.
+void keepBest(std::vector<size_t>& indices, size_t keep, const std::function<double(size_t)>& score) {
+    std::stable_sort(indices.begin(), indices.end(), [&](size_t a, size_t b) { return score(a) > score(b); });
+    if (indices.size() > keep) indices.resize(keep);
+}
+
+}
+
+// Three stages of increasing cost: every point gets an analytic estimate,
+// the survivors of the screen get short pilot simulations, and only the
+// finalists get the full replication budget.
+std::vector<SweepPoint> multiFidelitySweep(const std::vector<Scenario>& grid, const Objective& objective,
+                                           const FidelityPolicy& policy) {
+    std::vector<SweepPoint> points(grid.size());
+    std::vector<size_t> survivors;
+    for (size_t i = 0; i < grid.size(); ++i) {
+        SweepPoint& p = points[i];
+        p.scenario = grid[i];
+        bool passes = true;
+        if (policy.fluidScreen) {
+            p.analyticScore = objective(grid[i], FluidModel(grid[i]).run(grid[i].duration));
+        } else {
+            ChargerEstimate e = estimateChargers(grid[i]);
+            p.analyticScore = objective(grid[i], e.expectedStats);
+            passes = passesScreen(e, policy.screen);
+        }
+        p.score = p.analyticScore;
+        if (passes) survivors.push_back(i);
+    }
+
+    size_t keep = std::max<size_t>(policy.finalists, std::ceil(survivors.size() * policy.screenKeepFraction));
+    keepBest(survivors, keep, [&](size_t i) { return points[i].analyticScore; });
+
+    for (size_t i : survivors) {
+        SweepPoint& p = points[i];
+        p.samples = pilot(p.scenario, policy.pilotWarmupCycles * cycleTime(p.scenario),
+                          policy.pilotDurationFraction * p.scenario.duration, policy.pilotReplications,
+                          objective, policy.threads, policy.cache);
+        p.pilotScore = p.score = mean(p.samples);
+        p.replications = policy.pilotReplications;
+        p.fidelity = PILOT;
+    }
+
+    keepBest(survivors, policy.finalists, [&](size_t i) { return points[i].pilotScore; });
+    for (size_t i : survivors) {
+        SweepPoint& p = points[i];
+        p.samples = simulate(p.scenario, policy.fullReplications, objective, policy.threads, policy.cache);
+        p.score = mean(p.samples);
+        p.replications = policy.fullReplications;
+        p.fidelity = FULL;
+    }
+
+    std::stable_sort(points.begin(), points.end(), [](const SweepPoint& a, const SweepPoint& b) {
+        if (a.fidelity != b.fidelity) return a.fidelity > b.fidelity;
+        return a.score > b.score;
+    });
+    return points;
+}
+
+OcbaResult ocbaSweep(const std::vector<Scenario>& grid, const Objective& objective, const OcbaPolicy& policy) {
+    OcbaResult result;
+    if (grid.empty()) return result;
+    std::vector<SweepPoint> points(grid.size());
+    for (size_t i = 0; i < grid.size(); ++i) {
+        points[i].scenario = grid[i];
+        points[i].fidelity = FULL;
+    }
+    int initial = std::max(2, policy.initialReplications);
+    extend(points, std::vector<int>(points.size(), initial), objective, policy.threads, policy.cache);
+    result.totalReplications = initial * points.size();
+
+    result.probabilityCorrect = probabilityCorrect(points);
+    while (result.totalReplications < policy.budget && result.probabilityCorrect < policy.targetPcs) {
+        int count = std::min(std::max(1, policy.increment), policy.budget - result.totalReplications);
+        extend(points, allocate(points, ocbaShares(points), count), objective, policy.threads, policy.cache);
+        result.totalReplications += count;
+        result.probabilityCorrect = probabilityCorrect(points);
+    }
+
+    std::stable_sort(points.begin(), points.end(),
+                     [](const SweepPoint& a, const SweepPoint& b) { return a.score > b.score; });
+    result.points = std::move(points);
+    return result;
+}
+
+double PairedComparison::varianceReduction() const {
+    double independent = first.variance() + second.variance();
+    return difference.variance() > 0 ? independent / difference.variance() : INFINITY;
+}
+
+PairedComparison compareScenarios(const Scenario& first, const Scenario& second, int replications,
+                                  const Objective& objective, int threads, ResultCache* cache) {
+    std::vector<Scenario> runs;
+    for (int r = 0; r < replications; ++r) {
+        for (const Scenario* s : {&first, &second}) {
+            runs.push_back(*s);
+            runs.back().seed = replicationSeed(first.seed, r);
+            runs.back().commonRandomNumbers = true;
+        }
+    }
+    std::vector<StatsTable> results = runBatch(runs, threads, cache);
+
+    PairedComparison c;
+    for (int r = 0; r < replications; ++r) {
+        double a = objective(runs[2 * r], results[2 * r]);
+        double b = objective(runs[2 * r + 1], results[2 * r + 1]);
+        c.first.add(a);
+        c.second.add(b);
+        c.difference.add(a - b);
+    }
+    return c;
+}
+
+void setParameter(Scenario& scenario, const ParameterRange& range, double u) {
+    double x = range.low + u * (range.high - range.low);
+    if (range.parameter == CHARGERS) {
+        scenario.numChargers = std::max<long>(1, std::lround(x));
+        return;
+    }
+    if (range.parameter == VEHICLES) {
+        scenario.numVehicles = std::max<long>(1, std::lround(x));
+        return;
+    }
+    for (auto& t : scenario.vehicleTypes) {
+        if (t.company != range.company) continue;
+        switch (range.parameter) {
+            case CRUISE_SPEED: t.cruiseSpeed = x; break;
+            case BATTERY_CAPACITY: t.batteryCapacity = x; break;
+            case TIME_TO_CHARGE: t.timeToCharge = x; break;
+            case ENERGY_PER_MILE: t.energyPerMile = x; break;
+            case PASSENGER_COUNT: t.passengerCount = std::lround(x); break;
+            case FAULT_PROBABILITY: t.faultProbPerHour = x; break;
+            default: break;
+        }
+    }
+}
+
+double parameterPosition(const Scenario& scenario, const ParameterRange& range) {
+    double x = 0;
+    if (range.parameter == CHARGERS) x = scenario.numChargers;
+    if (range.parameter == VEHICLES) x = scenario.numVehicles;
+    for (const auto& t : scenario.vehicleTypes) {
+        if (t.company != range.company || range.parameter >= CHARGERS) continue;
+        switch (range.parameter) {
+            case CRUISE_SPEED: x = t.cruiseSpeed; break;
+            case BATTERY_CAPACITY: x = t.batteryCapacity; break;
+            case TIME_TO_CHARGE: x = t.timeToCharge; break;
+            case ENERGY_PER_MILE: x = t.energyPerMile; break;
+            case PASSENGER_COUNT: x = t.passengerCount; break;
+            case FAULT_PROBABILITY: x = t.faultProbPerHour; break;
+            default: break;
+        }
+        break;
+    }
+    return range.high != range.low ? (x - range.low) / (range.high - range.low) : 0.0;
+}
+
+std::vector<Scenario> sobolDesign(const Scenario& base, const std::vector<ParameterRange>& ranges, int points,
+                                  unsigned scrambleSeed) {
+    SobolSequence sobol(ranges.size(), scrambleSeed);
+    std::vector<Scenario> design(std::max(points, 0), base);
+    for (int i = 0; i < points; ++i) {
+        std::vector<double> u = sobol.point(i);
+        for (size_t k = 0; k < ranges.size(); ++k) setParameter(design[i], ranges[k], u[k]);
+    }
+    return design;
+}
+
+UncertaintyResult propagateUncertainty(const Scenario& base, const std::vector<ParameterRange>& ranges,
+                                       int points, int scrambles, const Objective& objective, int threads,
+                                       ResultCache* cache) {
+    std::vector<Scenario> runs;
+    for (int s = 0; s < scrambles; ++s) {
+        for (Scenario& sc : sobolDesign(base, ranges, points, replicationSeed(base.seed, s))) {
+            sc.seed = replicationSeed(base.seed, runs.size());
+            runs.push_back(std::move(sc));
+        }
+    }
+    std::vector<StatsTable> results = runBatch(runs, threads, cache);
+
+    UncertaintyResult result;
+    result.runs = runs.size();
+    RunningMoments between;
+    for (int s = 0; s < scrambles; ++s) {
+        RunningMoments within;
+        for (int i = 0; i < points; ++i) {
+            size_t j = size_t(s) * points + i;
+            double y = objective(runs[j], results[j]);
+            within.add(y);
+            result.objective.add(y);
+        }
+        result.scrambleMeans.push_back(within.mean);
+        between.add(within.mean);
+    }
+    result.standardError = std::sqrt(between.variance() / std::max<long long>(between.count, 1));
+    return result;
+}
@@ -0,0 +1,123 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "QueueingModel.h"
+#include "Replication.h"
+#include "Sobol.h"
+
+// Higher is better. Evaluated on one run's stats (or an analytic estimate).
+using Objective = std::function<double(const Scenario&, const StatsTable&)>;
+
+double totalPassengerMiles(const Scenario& scenario, const StatsTable& stats);
+// Passenger-miles minus a fixed passenger-mile cost per charger.
+Objective netPassengerMiles(double milesPerCharger);
+
+struct FidelityPolicy {
+    ScreeningCriteria screen;
+    bool fluidScreen = false;          // rank with the fluid model instead of MVA
+    double screenKeepFraction = 0.5;   // of the points passing the screen
+    double pilotWarmupCycles = 1.0;    // cold start before measuring, in longest flight + charge cycles
+    double pilotDurationFraction = 0.25;  // of the horizon, measured after the warm-up
+    int pilotReplications = 2;
+    int finalists = 3;
+    int fullReplications = 20;
+    int threads = std::thread::hardware_concurrency();
+    ResultCache* cache = nullptr;      // consulted by the pilot and full stages
+};
+
+enum Fidelity { ANALYTIC, PILOT, FULL };
+
+struct SweepPoint {
+    Scenario scenario;
+    Fidelity fidelity = ANALYTIC;
+    double analyticScore = 0;
+    double pilotScore = 0;
+    double score = 0;                  // at the highest fidelity reached
+    int replications = 0;              // at that fidelity, one per sample
+    std::vector<double> samples;       // per-replication objective at that fidelity
+};
+
+// Grid points sorted best first, full-fidelity points ahead of the rest.
+std::vector<SweepPoint> multiFidelitySweep(const std::vector<Scenario>& grid,
+                                           const Objective& objective = totalPassengerMiles,
+                                           const FidelityPolicy& policy = FidelityPolicy());
+
+struct OcbaPolicy {
+    int initialReplications = 5;
+    int increment = 10;                // replications added per round, across all points
+    int budget = 200;                  // total replications, initial ones included
+    double targetPcs = 0.95;           // stop early once the best is this likely to be correct
+    int threads = std::thread::hardware_concurrency();
+    ResultCache* cache = nullptr;
+};
+
+struct OcbaResult {
+    std::vector<SweepPoint> points;    // best first
+    double probabilityCorrect = 0;     // Bonferroni lower bound that points[0] is the best
+    int totalReplications = 0;
+};
+
+// Optimal computing budget allocation: after the initial replications,
+// each round gives the next increment to the points the OCBA ratios
+//   N_i / N_j = (s_i / d_i)^2 / (s_j / d_j)^2,  N_b = s_b sqrt(sum N_i^2 / s_i^2)
+// say are furthest below their share, where d_i is the gap to the current
+// best b. Points clearly worse than the best stop receiving runs, so
+// picking the best takes far fewer runs than an even split.
+OcbaResult ocbaSweep(const std::vector<Scenario>& grid, const Objective& objective = totalPassengerMiles,
+                     const OcbaPolicy& policy = OcbaPolicy());
+
+struct PairedComparison {
+    RunningMoments first, second;
+    RunningMoments difference;         // first - second, replication by replication
+    double varianceReduction() const;  // of the difference, against independent runs
+};
+
+// Runs replication r of both scenarios with common random numbers and the
+// same seed, so the difference in objective reflects the change between
+// them rather than different vehicles and different fault luck.
+PairedComparison compareScenarios(const Scenario& first, const Scenario& second, int replications,
+                                  const Objective& objective = totalPassengerMiles,
+                                  int threads = std::thread::hardware_concurrency(), ResultCache* cache = nullptr);
+
+enum ScenarioParameter {
+    CRUISE_SPEED, BATTERY_CAPACITY, TIME_TO_CHARGE, ENERGY_PER_MILE, PASSENGER_COUNT, FAULT_PROBABILITY,
+    CHARGERS, VEHICLES
+};
+extern const std::vector<std::string> parameterNames;
+
+// A parameter varied uniformly over [low, high]. Vehicle parameters apply
+// to every type of `company`; counts are rounded.
+struct ParameterRange {
+    ScenarioParameter parameter;
+    Company company = ALPHA;
+    double low;
+    double high;
+};
+
+// Sets the parameter to low + u (high - low); parameterPosition is the
+// inverse, reading u back from a scenario.
+void setParameter(Scenario& scenario, const ParameterRange& range, double u);
+double parameterPosition(const Scenario& scenario, const ParameterRange& range);
+
+// `points` scenarios at the points of a scrambled Sobol sequence over the
+// ranges, all sharing base's seed; usable as a sweep grid.
+std::vector<Scenario> sobolDesign(const Scenario& base, const std::vector<ParameterRange>& ranges, int points,
+                                  unsigned scrambleSeed);
+
+struct UncertaintyResult {
+    RunningMoments objective;           // over all runs
+    std::vector<double> scrambleMeans;
+    double standardError = 0;           // of the mean, from the spread between scrambles
+    int runs = 0;
+};
+
+// Mean of the objective over the parameter uncertainty: one run per design
+// point, over `scrambles` independently scrambled Sobol designs. Powers of
+// two for `points` keep the designs balanced.
+UncertaintyResult propagateUncertainty(const Scenario& base, const std::vector<ParameterRange>& ranges,
+                                       int points, int scrambles = 8,
+                                       const Objective& objective = totalPassengerMiles,
+                                       int threads = std::thread::hardware_concurrency(),
+                                       ResultCache* cache = nullptr);
+
+#endif
@@ -0,0 +1,140 @@
+#include "TimeParallel.h"
+#include "Replication.h"
+
+#include <cmath>
+
+namespace {
+
+struct Window {
+    bool valid = false;
+    FleetState start;
+    FleetState end;
+    std::map<Company, Stats> stats;
+};
+
+bool operator==(const FleetState& a, const FleetState& b) {
+    return a.flying == b.flying && a.queued == b.queued && a.charging == b.charging;
+}
+
+// Keeps a corrected state physical: no negative counts, every type's counts
+// summing to its fleet size, and no more vehicles charging than chargers.
+void project(FleetState& x, const std::vector<int>& fleet, int chargers) {
+    double charging = 0;
+    for (size_t i = 0; i < fleet.size(); ++i) {
+        x.flying[i] = std::max(x.flying[i], 0.0);
+        x.queued[i] = std::max(x.queued[i], 0.0);
+        x.charging[i] = std::max(x.charging[i], 0.0);
+        double sum = x.flying[i] + x.queued[i] + x.charging[i];
+        double scale = sum > 0 ? fleet[i] / sum : 0.0;
+        x.flying[i] *= scale;
+        x.queued[i] *= scale;
+        x.charging[i] *= scale;
+        charging += x.charging[i];
+    }
+    if (charging > chargers) {
+        double keep = chargers / charging;
+        for (size_t i = 0; i < fleet.size(); ++i) {
+            x.queued[i] += x.charging[i] * (1 - keep);
+            x.charging[i] *= keep;
+        }
+    }
+}
+
+std::map<Company, Stats> sumWindows(const std::vector<Window>& windows) {
+    std::map<Company, Stats> total;
+    for (const auto& w : windows)
+        for (const auto& [comp, stat] : w.stats) total[comp] += stat;
+    return total;
+}
+
+double relativeChange(const std::map<Company, Stats>& a, const std::map<Company, Stats>& b) {
+    double d = 0;
+    for (const auto& [comp, x] : a) {
+        auto it = b.find(comp);
+        Stats y = it == b.end() ? Stats() : it->second;
+        d = std::max(d, std::abs(x.passengerMiles - y.passengerMiles) / std::max(std::abs(y.passengerMiles), 1.0));
+        d = std::max(d, std::abs(x.totalFlights - y.totalFlights) / std::max(std::abs(double(y.totalFlights)), 1.0));
+    }
+    return d;
+}
+
+double maxChange(const FleetState& a, const FleetState& b) {
+    double d = 0;
+    for (size_t i = 0; i < a.flying.size(); ++i)
+        d = std::max({d, std::abs(a.flying[i] - b.flying[i]), std::abs(a.queued[i] - b.queued[i]),
+                      std::abs(a.charging[i] - b.charging[i])});
+    return d;
+}
+
+}
+
+PararealResult runParareal(const Scenario& scenario, const PararealOptions& options) {
+    Scenario sc = scenario;
+    if (sc.fleetMix.empty()) {
+        FleetState drawn = Simulation(sc).fleetState();
+        for (double n : drawn.flying) sc.fleetMix.push_back(int(n));
+    }
+
+    int windows = std::max(1, options.windows);
+    int maxIterations = options.maxIterations > 0 ? options.maxIterations : windows;
+    double dt = sc.duration / windows;
+    FluidModel coarse(sc);
+
+    std::vector<FleetState> start(windows + 1), coarseEnd(windows);
+    start[0] = coarse.initialState();
+    for (int k = 0; k < windows; ++k) {
+        coarseEnd[k] = coarse.advance(start[k], dt);
+        start[k + 1] = coarseEnd[k];
+    }
+
+    // Window 0 starts from the real initial condition (every vehicle taking
+    // off at once) rather than a lifted one.
+    std::vector<Window> fine(windows);
+    auto runWindow = [&](int k) {
+        Scenario ws = sc;
+        ws.seed = sc.seed ^ (0x9e3779b9u * unsigned(k + 1));
+        Simulation sim(ws);
+        if (k > 0) sim.liftFleetState(start[k], k * dt);
+        sim.runUntil((k + 1) * dt);
+        fine[k].valid = true;
+        fine[k].start = start[k];
+        fine[k].end = sim.fleetState();
+        fine[k].stats = sim.getStats();
+    };
+
+    PararealResult result;
+    for (int iter = 0; iter < maxIterations; ++iter) {
+        std::vector<int> stale;
+        for (int k = 0; k < windows; ++k)
+            if (!fine[k].valid || !(fine[k].start == start[k])) stale.push_back(k);
+        result.fineRuns += stale.size();
+
+        parallelFor(stale.size(), options.threads, [&](size_t i) { runWindow(stale[i]); });
+
+        double change = 0;
+        std::vector<FleetState> corrected(windows + 1);
+        corrected[0] = start[0];
+        for (int k = 0; k < windows; ++k) {
+            FleetState predicted = coarse.advance(corrected[k], dt);
+            FleetState next = predicted;
+            for (size_t i = 0; i < next.flying.size(); ++i) {
+                next.flying[i] += fine[k].end.flying[i] - coarseEnd[k].flying[i];
+                next.queued[i] += fine[k].end.queued[i] - coarseEnd[k].queued[i];
+                next.charging[i] += fine[k].end.charging[i] - coarseEnd[k].charging[i];
+            }
+            project(next, sc.fleetMix, sc.numChargers);
+            coarseEnd[k] = predicted;
+            corrected[k + 1] = next;
+            change = std::max(change, maxChange(next, start[k + 1]));
+        }
+        start = corrected;
+        result.iterations = iter + 1;
+        result.corrections.push_back(change);
+
+        auto totals = sumWindows(fine);
+        bool converged = iter > 0 && relativeChange(totals, result.stats) <= options.tolerance;
+        result.stats = totals;
+        if (converged) break;
+    }
+    return result;
+}
@@ -0,0 +1,39 @@
+#ifndef TIME_PARALLEL_H
+#define TIME_PARALLEL_H
+
+#include "FluidModel.h"
+
+#include <thread>
+
+struct PararealOptions {
+    int windows = 8;
+    int threads = std::thread::hardware_concurrency();
+    int maxIterations = 0;    // 0: one per window
+    double tolerance = 0.01;  // relative change of per-company totals between iterations
+};
+
+struct PararealResult {
+    std::map<Company, Stats> stats;
+    int iterations = 0;
+    int fineRuns = 0;
+    std::vector<double> corrections;
+};
+
+// Time-parallel run: the horizon is split into windows whose start states
+// are predicted by the fluid model, every window is simulated in parallel
+// from its predicted state, and the parareal correction
+//   U[k+1] = G(U[k]) + F(U_old[k]) - G(U_old[k])
+// is iterated until the per-company flight and passenger-mile totals stop
+// moving. Window-start states keep jittering by a few vehicles (the fine
+// runs are stochastic), so convergence is judged on the statistics; the
+// largest state correction of each iteration is reported alongside. Each
+// window draws from its own seed, so a window whose start state did not
+// change is not rerun.
+//
+// The result approximates a sequential run rather than reproducing it, at
+// any iteration count: every window after the first restarts from an
+// aggregate state lifted onto individual vehicles (see liftFleetState) and
+// draws from a different seed than the sequential run would.
+PararealResult runParareal(const Scenario& scenario, const PararealOptions& options = PararealOptions());
+
+#endif
@@ -0,0 +1,186 @@
+#include "TimeWarpNetwork.h"
+
+#include <limits>
+
+TimeWarpNetwork::TimeWarpNetwork(const NetworkScenario& scenario)
+    : scenario(scenario), routes(scenario.vehicleTypes, scenario.numVertiports, scenario.sitePositions) {
+    int types = scenario.vehicleTypes.size();
+    for (int s = 0; s < scenario.numVertiports; ++s) {
+        sites.push_back(std::make_unique<LogicalProcess>(s, this->scenario, routes));
+        for (int k = 0; k < scenario.vehiclesPerVertiport; ++k) {
+            int id = s * scenario.vehiclesPerVertiport + k;
+            double r = counterUniform(scenario.seed, uint64_t(id) * NUM_STREAMS + TYPE_STREAM, 0);
+            NetVehicle v{id, std::min(int(r * types), types - 1), 0};
+            fleet.push_back(v.type);
+            sites[s]->model.depart(v, 0.0);
+        }
+    }
+
+    // Initial departures went to the model's outboxes; seed them directly.
+    for (auto& lp : sites) {
+        for (auto& box : lp->model.outbox) {
+            for (auto m : box) {
+                m.uid = (uint64_t(lp->model.site) << 40) | lp->nextUid++;
+                sites[m.destination]->pending.insert(m);
+            }
+            box.clear();
+        }
+        lp->model.sentTo.clear();
+    }
+}
+
+void TimeWarpNetwork::send(const NetEvent& e, bool anti) {
+    LogicalProcess& to = *sites[e.destination];
+    std::lock_guard<std::mutex> lock(to.inboxMutex);
+    to.inbox.push_back({e, anti});
+}
+
+void TimeWarpNetwork::processNext(LogicalProcess& lp) {
+    NetEvent e = *lp.pending.begin();
+    lp.pending.erase(lp.pending.begin());
+
+    lp.processed.push_back({e, {}});
+    LPStateDelta& delta = lp.processed.back().delta;
+    lp.model.log = &delta;
+    lp.model.handle(e);
+    lp.model.log = nullptr;
+
+    for (auto& m : delta.sent) {
+        m.uid = (uint64_t(lp.model.site) << 40) | lp.nextUid++;
+        send(m, false);
+    }
+    lp.counters.processed++;
+}
+
+// Undoes processed events newest first until only `keep` remain, returning
+// them to the pending set and cancelling everything they sent.
+void TimeWarpNetwork::rollback(LogicalProcess& lp, size_t keep) {
+    while (lp.processed.size() > keep) {
+        Processed& p = lp.processed.back();
+        lp.model.undo(p.delta);
+        for (const auto& m : p.delta.sent) {
+            send(m, true);
+            lp.counters.antiMessages++;
+        }
+        lp.pending.insert(p.event);
+        lp.processed.pop_back();
+        lp.counters.rolledBack++;
+    }
+}
+
+// A message never arrives before the positive copy it cancels: both travel
+// through the same FIFO inbox and the anti-message is sent second.
+void TimeWarpNetwork::drainInbox(LogicalProcess& lp) {
+    std::vector<Message> incoming;
+    {
+        std::lock_guard<std::mutex> lock(lp.inboxMutex);
+        incoming.swap(lp.inbox);
+    }
+
+    Earlier earlier;
+    for (const auto& m : incoming) {
+        if (!m.anti) {
+            if (!lp.processed.empty() && earlier(m.event, lp.processed.back().event)) {
+                auto first = std::upper_bound(lp.processed.begin(), lp.processed.end(), m.event,
+                                              [&](const NetEvent& e, const Processed& p) { return earlier(e, p.event); });
+                rollback(lp, first - lp.processed.begin());
+            }
+            lp.pending.insert(m.event);
+            continue;
+        }
+
+        auto it = lp.pending.find(m.event);
+        if (it == lp.pending.end()) {
+            for (size_t i = lp.processed.size(); i-- > 0;) {
+                if (lp.processed[i].event.uid == m.event.uid) {
+                    rollback(lp, i);
+                    break;
+                }
+            }
+            it = lp.pending.find(m.event);
+        }
+        if (it != lp.pending.end()) lp.pending.erase(it);
+    }
+}
+
+double TimeWarpNetwork::localMinimum(LogicalProcess& lp) {
+    double t = lp.pending.empty() ? std::numeric_limits<double>::infinity() : lp.pending.begin()->time;
+    std::lock_guard<std::mutex> lock(lp.inboxMutex);
+    for (const auto& m : lp.inbox) t = std::min(t, m.event.time);
+    return t;
+}
+
+void TimeWarpNetwork::fossilCollect(LogicalProcess& lp, double gvt) {
+    size_t n = 0;
+    while (n < lp.processed.size() && lp.processed[n].event.time < gvt) n++;
+    lp.processed.erase(lp.processed.begin(), lp.processed.begin() + n);
+}
+
+void TimeWarpNetwork::run(int threads, int batch) {
+    int numSites = sites.size();
+    threads = std::max(1, std::min(threads, numSites));
+    double horizon = scenario.duration;
+    double gvt = 0.0;
+    Barrier barrier(threads);
+
+    // Every thread works through a batch of events, then all of them stop so
+    // GVT can be read off the pending sets and inboxes with nothing in
+    // flight.
+    auto worker = [&](int t) {
+        while (true) {
+            for (int iter = 0; iter < batch; ++iter) {
+                bool progressed = false;
+                for (int s = t; s < numSites; s += threads) {
+                    LogicalProcess& lp = *sites[s];
+                    drainInbox(lp);
+                    if (!lp.pending.empty() && lp.pending.begin()->time <= horizon) {
+                        processNext(lp);
+                        progressed = true;
+                    }
+                }
+                if (!progressed) break;
+            }
+            barrier.wait();
+
+            if (t == 0) {
+                gvt = std::numeric_limits<double>::infinity();
+                for (auto& lp : sites) gvt = std::min(gvt, localMinimum(*lp));
+                gvtRounds++;
+            }
+            barrier.wait();
+
+            if (gvt > horizon) break;
+            for (int s = t; s < numSites; s += threads)
+                fossilCollect(*sites[s], gvt);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& th : pool) th.join();
+}
+
+std::map<Company, Stats> TimeWarpNetwork::getStats() const {
+    std::map<Company, Stats> total;
+    for (const auto& lp : sites)
+        for (const auto& [comp, stat] : lp->model.stats) total[comp] += stat;
+    return total;
+}
+
+void TimeWarpNetwork::printStats() const {
+    std::map<Company, int> vehicleCount;
+    for (int type : fleet) vehicleCount[scenario.vehicleTypes[type].company]++;
+    ::printStats(getStats(), vehicleCount);
+}
+
+TimeWarpCounters TimeWarpNetwork::getCounters() const {
+    TimeWarpCounters total;
+    for (const auto& lp : sites) {
+        total.processed += lp->counters.processed;
+        total.rolledBack += lp->counters.rolledBack;
+        total.antiMessages += lp->counters.antiMessages;
+    }
+    total.gvtRounds = gvtRounds;
+    return total;
+}
@@ -0,0 +1,72 @@
+#ifndef TIME_WARP_NETWORK_H
+#define TIME_WARP_NETWORK_H
+
+#include "VertiportNetwork.h"
+
+#include <set>
+
+struct TimeWarpCounters {
+    uint64_t processed = 0;
+    uint64_t rolledBack = 0;
+    uint64_t antiMessages = 0;
+    uint64_t gvtRounds = 0;
+};
+
+// Optimistic (Time Warp) engine over the same vertiport model as
+// VertiportNetwork. Each site executes speculatively, logging the
+// before-images of every event; a straggler or anti-message rolls it back
+// and cancels what the undone events sent. GVT is computed synchronously
+// every `batch` events per thread, after which history older than GVT is
+// fossil-collected. Committed results match the conservative engine.
+class TimeWarpNetwork {
+public:
+    explicit TimeWarpNetwork(const NetworkScenario& scenario);
+    TimeWarpNetwork(const TimeWarpNetwork&) = delete;
+    TimeWarpNetwork& operator=(const TimeWarpNetwork&) = delete;
+    void run(int threads = std::thread::hardware_concurrency(), int batch = 256);
+    std::map<Company, Stats> getStats() const;
+    void printStats() const;
+    TimeWarpCounters getCounters() const;
+
+private:
+    struct Earlier {
+        bool operator()(const NetEvent& a, const NetEvent& b) const { return b > a; }
+    };
+
+    struct Message {
+        NetEvent event;
+        bool anti;
+    };
+
+    struct Processed {
+        NetEvent event;
+        LPStateDelta delta;
+    };
+
+    struct LogicalProcess {
+        LogicalProcess(int site, const NetworkScenario& scenario, const RouteTable& routes)
+            : model(site, scenario, routes) {}
+        VertiportLP model;
+        std::set<NetEvent, Earlier> pending;
+        std::deque<Processed> processed;
+        std::mutex inboxMutex;
+        std::vector<Message> inbox;
+        uint64_t nextUid = 0;
+        TimeWarpCounters counters;
+    };
+
+    void send(const NetEvent& e, bool anti);
+    void drainInbox(LogicalProcess& lp);
+    void rollback(LogicalProcess& lp, size_t keep);
+    void processNext(LogicalProcess& lp);
+    double localMinimum(LogicalProcess& lp);
+    void fossilCollect(LogicalProcess& lp, double gvt);
+
+    NetworkScenario scenario;
+    RouteTable routes;
+    std::vector<std::unique_ptr<LogicalProcess>> sites;
+    std::vector<int> fleet;
+    uint64_t gvtRounds = 0;
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "VertiportNetwork.h"
+
+#include <limits>
+
+bool NetEvent::operator>(const NetEvent& other) const {
+    if (time != other.time) return time > other.time;
+    if (vehicle.id != other.vehicle.id) return vehicle.id > other.vehicle.id;
+    if (kind != other.kind) return kind > other.kind;
+    return uid > other.uid;
+}
+
+void Barrier::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t gen = generation;
+    if (++waiting == count) {
+        waiting = 0;
+        generation++;
+        cv.notify_all();
+    } else {
+        cv.wait(lock, [&] { return gen != generation; });
+    }
+}
+
+VertiportLP::VertiportLP(int site, const NetworkScenario& scenario, const RouteTable& routes)
+    : site(site), outbox(scenario.numVertiports), scenario(scenario), routes(routes),
+      chargers(scenario.siteChargers.empty() ? scenario.chargersPerVertiport : scenario.siteChargers.at(site), false) {}
+
+double VertiportLP::nextEventTime() const {
+    return events.empty() ? std::numeric_limits<double>::infinity() : events.front().time;
+}
+
+void VertiportLP::schedule(const NetEvent& e) {
+    events.push_back(e);
+    std::push_heap(events.begin(), events.end(), std::greater<NetEvent>());
+}
+
+void VertiportLP::processUntil(double windowEnd, double horizon) {
+    while (!events.empty() && events.front().time < windowEnd && events.front().time <= horizon) {
+        std::pop_heap(events.begin(), events.end(), std::greater<NetEvent>());
+        NetEvent e = events.back();
+        events.pop_back();
+        handle(e);
+    }
+}
+
+// A vehicle at the end of its trip draws a new destination; one part way
+// through flies the next leg of its route.
+void VertiportLP::depart(const NetVehicle& v, double time) {
+    int sites = scenario.numVertiports;
+    NetEvent arrival{time, ARRIVAL, v};
+    if (v.target < 0 || v.target == site) {
+        arrival.vehicle.target = site;
+        if (sites > 1) {
+            double r = counterUniform(scenario.seed, uint64_t(v.id) * NUM_STREAMS + ROUTE_STREAM, v.flights);
+            arrival.vehicle.target = (site + 1 + int(r * (sites - 1))) % sites;
+        }
+    }
+
+    arrival.destination = routes.nextHop(v.type, site, arrival.vehicle.target);
+    arrival.flightTime = routes.legTime(v.type, site, arrival.destination);
+    arrival.time = time + arrival.flightTime;
+    emit(arrival, false);
+}
+
+void VertiportLP::emit(NetEvent e, bool local) {
+    if (local) e.destination = site;
+    if (log)
+        log->sent.push_back(e);
+    else if (local)
+        schedule(e);
+    else {
+        if (outbox[e.destination].empty()) sentTo.push_back(e.destination);
+        outbox[e.destination].push_back(e);
+    }
+}
+
+void VertiportLP::handle(const NetEvent& e) {
+    NetVehicle v = e.vehicle;
+    const VehicleType& t = scenario.vehicleTypes[v.type];
+    Stats& s = stats[t.company];
+    if (log) {
+        log->company = t.company;
+        log->stats = s;
+    }
+
+    switch (e.kind) {
+    case ARRIVAL: {
+        double distance = t.cruiseSpeed * e.flightTime;
+        s.totalFlightTime += e.flightTime;
+        s.totalDistance += distance;
+        s.totalFlights++;
+        s.passengerMiles += t.passengerCount * distance;
+        double p = std::min(t.faultProbPerHour * e.flightTime, 1.0);
+        if (counterUniform(scenario.seed, uint64_t(v.id) * NUM_STREAMS + FAULT_STREAM, v.flights) < p)
+            s.totalFaults++;
+        s.expectedFaults += p;
+        v.flights++;
+        v.chargeTime = t.timeToCharge * (e.flightTime / (t.batteryCapacity / (t.cruiseSpeed * t.energyPerMile)));
+        chargingQueue.push_back(v);
+        if (log) log->pushed++;
+        break;
+    }
+    case CHARGE_DONE:
+        s.totalChargeTime += v.chargeTime;
+        s.totalCharges++;
+        // An orphan completion (its anti-message still on the way) may find
+        // the charger already idle, so log what it really was.
+        if (log) log->chargers.push_back({e.charger, chargers[e.charger]});
+        chargers[e.charger] = false;
+        depart(v, e.time);
+        break;
+    }
+    tryCharging(e.time);
+}
+
+void VertiportLP::tryCharging(double time) {
+    for (size_t i = 0; i < chargers.size() && !chargingQueue.empty(); ++i) {
+        if (chargers[i]) continue;
+        NetVehicle v = chargingQueue.front();
+        chargingQueue.pop_front();
+        chargers[i] = true;
+        if (log) {
+            log->popped.push_back(v);
+            log->chargers.push_back({int(i), false});
+        }
+        NetEvent done{time + v.chargeTime, CHARGE_DONE, v};
+        done.charger = i;
+        emit(done, true);
+    }
+}
+
+// Reverses handle() from its before-images: queue pops are pushed back to
+// the front before the arrival's push is taken off the back.
+void VertiportLP::undo(const LPStateDelta& delta) {
+    stats[delta.company] = delta.stats;
+    for (auto it = delta.chargers.rbegin(); it != delta.chargers.rend(); ++it)
+        chargers[it->first] = it->second;
+    for (auto it = delta.popped.rbegin(); it != delta.popped.rend(); ++it)
+        chargingQueue.push_front(*it);
+    for (int i = 0; i < delta.pushed; ++i)
+        chargingQueue.pop_back();
+}
+
+VertiportNetwork::VertiportNetwork(const NetworkScenario& scenario)
+    : scenario(scenario), routes(scenario.vehicleTypes, scenario.numVertiports, scenario.sitePositions) {
+    lookahead = routes.minLeg();
+
+    sites.reserve(scenario.numVertiports);
+    int types = scenario.vehicleTypes.size();
+    for (int s = 0; s < scenario.numVertiports; ++s) {
+        sites.emplace_back(s, this->scenario, routes);
+        for (int k = 0; k < scenario.vehiclesPerVertiport; ++k) {
+            int id = s * scenario.vehiclesPerVertiport + k;
+            double r = counterUniform(scenario.seed, uint64_t(id) * NUM_STREAMS + TYPE_STREAM, 0);
+            NetVehicle v{id, std::min(int(r * types), types - 1), 0};
+            fleet.push_back(v.type);
+            sites[s].depart(v, 0.0);
+        }
+    }
+}
+
+void VertiportNetwork::run(int threads) {
+    int numSites = sites.size();
+    threads = std::max(1, std::min(threads, numSites));
+    double horizon = scenario.duration;
+    std::vector<double> nextTimes(numSites);
+    Barrier barrier(threads);
+
+    // Two barriers per window: after message delivery (so every thread sees
+    // the same global minimum) and after processing (so outboxes are final).
+    // Each thread delivers to the sites it owns, taking sources in site order
+    // so the result does not depend on the thread count; a source's list of
+    // used outboxes is only cleared by its owner once delivery is over.
+    auto worker = [&](int t) {
+        while (true) {
+            for (const auto& src : sites) {
+                for (int dst : src.sentTo) {
+                    if (dst % threads != t) continue;
+                    auto& box = sites[src.site].outbox[dst];
+                    for (const auto& m : box) sites[dst].schedule(m);
+                    box.clear();
+                }
+            }
+            for (int dst = t; dst < numSites; dst += threads) nextTimes[dst] = sites[dst].nextEventTime();
+            barrier.wait();
+
+            double windowStart = *std::min_element(nextTimes.begin(), nextTimes.end());
+            if (windowStart > horizon) break;
+            for (int dst = t; dst < numSites; dst += threads) {
+                sites[dst].sentTo.clear();
+                sites[dst].processUntil(windowStart + routes.minLegInto(dst), horizon);
+            }
+            barrier.wait();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& th : pool) th.join();
+}
+
+std::map<Company, Stats> VertiportNetwork::getStats() const {
+    std::map<Company, Stats> total;
+    for (const auto& lp : sites)
+        for (const auto& [comp, stat] : lp.stats) total[comp] += stat;
+    return total;
+}
+
+void VertiportNetwork::printStats() const {
+    std::map<Company, int> vehicleCount;
+    for (int type : fleet) vehicleCount[scenario.vehicleTypes[type].company]++;
+    ::printStats(getStats(), vehicleCount);
+}
@@ -0,0 +1,134 @@
+#ifndef VERTIPORT_NETWORK_H
+#define VERTIPORT_NETWORK_H
+
+#include "VertiportRoutes.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+constexpr int NUM_VERTIPORTS = 4;
+
+// Multi-site variant of Scenario: every vertiport starts with its own fleet
+// and its own charger pool, and every trip goes to a different vertiport.
+// With sitePositions set, trips beyond a type's range stop to charge at
+// intermediate vertiports (see RouteTable).
+struct NetworkScenario {
+    std::vector<VehicleType> vehicleTypes = defaultVehicleTypes();
+    int numVertiports = NUM_VERTIPORTS;
+    int vehiclesPerVertiport = NUM_VEHICLES;
+    int chargersPerVertiport = NUM_CHARGERS;
+    std::vector<SitePosition> sitePositions;  // empty: every flight drains a full battery
+    std::vector<int> siteChargers;            // empty: chargersPerVertiport everywhere
+    double duration = SIM_DURATION;
+    unsigned seed = std::random_device()();
+};
+
+// Vehicles carry their own state between vertiports; `flights` is the
+// counter into the vehicle's fault and route random streams, `target` the
+// end of the current trip and `chargeTime` what the last leg used.
+struct NetVehicle {
+    int id;
+    int type;
+    uint32_t flights;
+    int target = -1;
+    double chargeTime = 0.0;
+};
+
+enum NetEventKind { ARRIVAL, CHARGE_DONE };
+
+// `uid` only matters to the optimistic engine, where it identifies the
+// message an anti-message cancels; it is the final ordering tie-break.
+struct NetEvent {
+    double time;
+    NetEventKind kind;
+    NetVehicle vehicle;
+    int charger = -1;
+    double flightTime = 0.0;
+    int destination = -1;
+    uint64_t uid = 0;
+    bool operator>(const NetEvent& other) const;
+};
+
+// Before-images of everything one event changed at a vertiport, recorded
+// when the optimistic engine needs to roll the event back. Events the
+// handler generated are collected in `sent` instead of being delivered.
+struct LPStateDelta {
+    Company company;
+    Stats stats;
+    std::vector<std::pair<int, bool>> chargers;
+    std::vector<NetVehicle> popped;
+    int pushed = 0;
+    std::vector<NetEvent> sent;
+};
+
+class Barrier {
+public:
+    explicit Barrier(int count) : count(count) {}
+    void wait();
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int count;
+    int waiting = 0;
+    uint64_t generation = 0;
+};
+
+// One logical process per vertiport. Every cross-site interaction is an
+// ARRIVAL message, and it is always at least one minimum flight time in the
+// future of the event that sent it.
+class VertiportLP {
+public:
+    VertiportLP(int site, const NetworkScenario& scenario, const RouteTable& routes);
+    double nextEventTime() const;
+    void schedule(const NetEvent& e);
+    void processUntil(double windowEnd, double horizon);
+    void depart(const NetVehicle& v, double time);
+    void handle(const NetEvent& e);
+    void undo(const LPStateDelta& delta);
+
+    int site;
+    std::map<Company, Stats> stats;
+    // ARRIVAL messages sent by this site, indexed by destination site, and
+    // the destinations whose outbox is not empty, in order of first use.
+    std::vector<std::vector<NetEvent>> outbox;
+    std::vector<int> sentTo;
+    LPStateDelta* log = nullptr;
+
+private:
+    void tryCharging(double time);
+    void emit(NetEvent e, bool local);
+
+    const NetworkScenario& scenario;
+    const RouteTable& routes;
+    std::vector<NetEvent> events;
+    std::vector<bool> chargers;
+    std::deque<NetVehicle> chargingQueue;
+};
+
+// Conservative parallel engine (YAWNS-style windows): each round every
+// vertiport processes its events earlier than the global minimum next event
+// time plus its own lookahead, the shortest leg into it, which no message
+// sent from then on can undercut. Delivery only visits the outboxes that
+// were used, so a window costs O(sites + messages) rather than O(sites^2).
+// Results are identical for any thread count.
+class VertiportNetwork {
+public:
+    explicit VertiportNetwork(const NetworkScenario& scenario);
+    VertiportNetwork(const VertiportNetwork&) = delete;
+    VertiportNetwork& operator=(const VertiportNetwork&) = delete;
+    void run(int threads = std::thread::hardware_concurrency());
+    std::map<Company, Stats> getStats() const;
+    void printStats() const;
+    double getLookahead() const { return lookahead; }  // the shortest over all sites
+
+private:
+    NetworkScenario scenario;
+    RouteTable routes;
+    std::vector<VertiportLP> sites;
+    std::vector<int> fleet;
+    double lookahead;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "VertiportRoutes.h"
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+std::vector<SitePosition> randomSites(int count, double radius, unsigned seed) {
+    std::default_random_engine rng(seed);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    std::vector<SitePosition> sites;
+    for (int i = 0; i < count; ++i) {
+        double r = radius * std::sqrt(u(rng)), a = 2 * std::acos(-1.0) * u(rng);
+        sites.push_back({r * std::cos(a), r * std::sin(a)});
+    }
+    return sites;
+}
+
+RouteTable::RouteTable(const std::vector<VehicleType>& types, int sites, const std::vector<SitePosition>& positions)
+    : n(sites), miles(size_t(n) * n), leg(types.size() * n * n), trip(types.size() * n * n),
+      next(types.size() * n * n), into(n, std::numeric_limits<double>::infinity()),
+      shortest(std::numeric_limits<double>::infinity()) {
+    const double inf = std::numeric_limits<double>::infinity();
+    bool geometry = !positions.empty();
+    if (geometry && int(positions.size()) != n)
+        throw std::runtime_error("expected " + std::to_string(n) + " vertiport positions, got " +
+                                 std::to_string(positions.size()));
+    if (geometry && n < 2) throw std::runtime_error("a positioned network needs at least two vertiports");
+
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+            if (geometry) miles[size_t(i) * n + j] = std::hypot(positions[i].x - positions[j].x, positions[i].y - positions[j].y);
+
+    for (size_t t = 0; t < types.size(); ++t) {
+        const VehicleType& vt = types[t];
+        double range = vt.batteryCapacity / vt.energyPerMile;
+        double fullFlight = range / vt.cruiseSpeed;
+        double* l = &leg[index(t, 0, 0)];
+        double* d = &trip[index(t, 0, 0)];
+        int* h = &next[index(t, 0, 0)];
+
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ++j) {
+                size_t ij = size_t(i) * n + j;
+                double m = miles[ij];
+                h[ij] = j;
+                if (!geometry) {
+                    l[ij] = fullFlight;
+                    d[ij] = fullFlight + vt.timeToCharge;
+                } else if (i == j) {
+                    l[ij] = d[ij] = 0.0;
+                } else if (m <= 0.0) {
+                    throw std::runtime_error("vertiports " + std::to_string(i) + " and " + std::to_string(j) +
+                                             " share a position");
+                } else if (m <= range) {
+                    l[ij] = m / vt.cruiseSpeed;
+                    d[ij] = l[ij] + vt.timeToCharge * m / range;
+                } else {
+                    l[ij] = d[ij] = inf;
+                    h[ij] = -1;
+                }
+                if (i != j || !geometry) {
+                    shortest = std::min(shortest, l[ij]);
+                    into[j] = std::min(into[j], l[ij]);
+                }
+            }
+        }
+        if (!geometry) continue;
+
+        for (int k = 0; k < n; ++k) {
+            const double* dk = d + size_t(k) * n;
+            for (int i = 0; i < n; ++i) {
+                double* di = d + size_t(i) * n;
+                int* hi = h + size_t(i) * n;
+                double dik = di[k];
+                if (dik == inf) continue;
+                int via = hi[k];
+                for (int j = 0; j < n; ++j) {
+                    double c = dik + dk[j];
+                    if (c < di[j]) {
+                        di[j] = c;
+                        hi[j] = via;
+                    }
+                }
+            }
+        }
+        for (size_t ij = 0; ij < size_t(n) * n; ++ij)
+            if (h[ij] < 0)
+                throw std::runtime_error("vertiport " + std::to_string(ij % n) + " is out of reach of vertiport " +
+                                         std::to_string(ij / n) + " for " + companyNames[vt.company]);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef VERTIPORT_ROUTES_H
+#define VERTIPORT_ROUTES_H
+
+#include "eVTOLSimulation.h"
+
+struct SitePosition {
+    double x, y;  // miles
+};
+
+// Sites scattered uniformly over a disc, e.g. for regional networks.
+std::vector<SitePosition> randomSites(int count, double radius, unsigned seed);
+
+// Dense per-type routing between vertiports, built once per network. A leg
+// is a direct flight within the type's range and costs its flight time plus
+// the charge that puts back the energy it used; longer trips go through
+// intermediate vertiports along the quickest chain of legs (Floyd-Warshall).
+// Without positions every leg is a full-battery flight followed by a full
+// charge, which is the original network model.
+class RouteTable {
+public:
+    RouteTable(const std::vector<VehicleType>& types, int sites, const std::vector<SitePosition>& positions);
+    int sites() const { return n; }
+    int nextHop(int type, int from, int to) const { return next[index(type, from, to)]; }
+    double legTime(int type, int from, int to) const { return leg[index(type, from, to)]; }
+    double tripTime(int type, int from, int to) const { return trip[index(type, from, to)]; }
+    double distance(int from, int to) const { return miles[size_t(from) * n + to]; }
+    // Shortest leg any type flies, overall and into one site: the lookahead
+    // between sites.
+    double minLeg() const { return shortest; }
+    double minLegInto(int to) const { return into[to]; }
+
+private:
+    size_t index(int type, int from, int to) const { return (size_t(type) * n + from) * n + to; }
+
+    int n;
+    std::vector<double> miles;
+    std::vector<double> leg, trip;
+    std::vector<int> next;
+    std::vector<double> into;
+    double shortest;
+};
+
+#endif
@@ -1,10 +1,35 @@
 #include "eVTOLSimulation.h"
 
-std::default_random_engine rng((std::random_device())());
-std::uniform_real_distribution<double> dist01(0.0, 1.0);
+#include <stdexcept>
+
 const std::vector<std::string> companyNames = {"Alpha", "Bravo", "Charlie", "Delta", "Echo"};
 
-Vehicle::Vehicle(VehicleType t) : type(t) {}
+Stats& operator+=(Stats& a, const Stats& b) {
+    a.totalFlightTime += b.totalFlightTime;
+    a.totalDistance += b.totalDistance;
+    a.totalChargeTime += b.totalChargeTime;
+    a.passengerMiles += b.passengerMiles;
+    a.totalFlights += b.totalFlights;
+    a.totalCharges += b.totalCharges;
+    a.totalFaults += b.totalFaults;
+    a.expectedFaults += b.expectedFaults;
+    return a;
+}
+
+Stats operator-(const Stats& a, const Stats& b) {
+    Stats d;
+    d.totalFlightTime = a.totalFlightTime - b.totalFlightTime;
+    d.totalDistance = a.totalDistance - b.totalDistance;
+    d.totalChargeTime = a.totalChargeTime - b.totalChargeTime;
+    d.passengerMiles = a.passengerMiles - b.passengerMiles;
+    d.totalFlights = a.totalFlights - b.totalFlights;
+    d.totalCharges = a.totalCharges - b.totalCharges;
+    d.totalFaults = a.totalFaults - b.totalFaults;
+    d.expectedFaults = a.expectedFaults - b.expectedFaults;
+    return d;
+}
+
+Vehicle::Vehicle(VehicleType t, int id, int typeIndex) : type(t), id(id), typeIndex(typeIndex) {}
 
 double Vehicle::getFlightDuration() {
     return type.batteryCapacity / (type.cruiseSpeed * type.energyPerMile);
@@ -18,14 +43,20 @@ bool Event::operator>(const Event& other) const {
     return time > other.time;
 }
 
-Simulation::Simulation() {
-    loadVehicleTypes();
-    createVehicles();
-    activeChargers.resize(NUM_CHARGERS);
+static uint64_t mix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
 }
 
-void Simulation::loadVehicleTypes() {
-    vehicleTypes = {
+double counterUniform(uint64_t seed, uint64_t stream, uint64_t counter) {
+    uint64_t bits = mix64(mix64(mix64(seed) ^ stream) ^ counter);
+    return (bits >> 11) * 0x1.0p-53;
+}
+
+std::vector<VehicleType> defaultVehicleTypes() {
+    return {
         {ALPHA, 120, 320, 0.6, 1.6, 4, 0.25},
         {BRAVO, 100, 100, 0.2, 1.5, 5, 0.10},
         {CHARLIE, 160, 220, 0.8, 2.2, 3, 0.05},
@@ -34,77 +65,334 @@ void Simulation::loadVehicleTypes() {
     };
 }
 
+Simulation::Simulation(const Scenario& scenario) : scenario(scenario), rng(scenario.seed) {
+    if (scenario.trackGradients && scenario.sitePower > 0)
+        throw std::runtime_error("gradient tracking assumes chargers run at their own rate");
+    if (stateOfCharge()) {
+        if (scenario.trackGradients || scenario.sitePower > 0)
+            throw std::runtime_error("the state-of-charge model needs uncapped chargers and no gradient tracking");
+        if (!(scenario.departureCharge > 0 && scenario.departureCharge <= 1))
+            throw std::runtime_error("departure charge must lie in (0, 1]");
+        curves = ChargeCurves(scenario.vehicleTypes, scenario.chargeKnee, scenario.chargeCutoff);
+    }
+    loadVehicleTypes();
+    createVehicles();
+    activeChargers.resize(scenario.numChargers);
+    chargerGeneration.resize(scenario.numChargers);
+    chargerPending.resize(scenario.numChargers);
+    chargerPower.resize(scenario.numChargers);
+}
+
+Simulation::Simulation(unsigned seed) : Simulation([seed] {
+    Scenario s;
+    s.seed = seed;
+    return s;
+}()) {}
+
+void Simulation::loadVehicleTypes() {
+    vehicleTypes = scenario.vehicleTypes;
+}
+
 void Simulation::createVehicles() {
     std::uniform_int_distribution<int> dist(0, vehicleTypes.size() - 1);
-    for (int i = 0; i < NUM_VEHICLES; ++i) {
-        VehicleType vt = vehicleTypes[dist(rng)];
-        auto v = std::make_shared<Vehicle>(vt);
+    std::vector<int> fleet;
+    for (size_t t = 0; t < scenario.fleetMix.size(); ++t)
+        fleet.insert(fleet.end(), scenario.fleetMix[t], t);
+    for (int i = 0; scenario.fleetMix.empty() && i < scenario.numVehicles; ++i) {
+        if (!scenario.commonRandomNumbers) {
+            fleet.push_back(dist(rng));
+            continue;
+        }
+        double r = counterUniform(scenario.seed, uint64_t(i) * NUM_STREAMS + TYPE_STREAM, 0);
+        fleet.push_back(std::min<int>(r * vehicleTypes.size(), vehicleTypes.size() - 1));
+    }
+
+    vehicleGeneration.resize(fleet.size());
+    vehiclePending.resize(fleet.size());
+    if (scenario.trackGradients) vehicleGradients.resize(fleet.size());
+    for (size_t i = 0; i < fleet.size(); ++i) {
+        VehicleType vt = vehicleTypes[fleet[i]];
+        auto v = std::make_shared<Vehicle>(vt, i, fleet[i]);
         vehicles.push_back(v);
         scheduleFlight(v, 0.0);
     }
 }
 
 void Simulation::scheduleFlight(std::shared_ptr<Vehicle> v, double startTime) {
-    double flightDuration = v->getFlightDuration();
-    if (startTime + flightDuration > SIM_DURATION) return;
+    double flightDuration = v->getFlightDuration() * v->charge;
 
-    eventQueue.push({startTime + flightDuration, [this, v, startTime, flightDuration]() {
-        processFlightEnd(v, startTime, flightDuration);
-    }});
+    Event e{startTime + flightDuration, FLIGHT_END};
+    e.vehicleId = v->id;
+    e.startTime = startTime;
+    e.duration = flightDuration;
+    pushEvent(e);
+    if (scenario.trackGradients) gradientFlightStart(*v, startTime);
 }
 
 void Simulation::processFlightEnd(std::shared_ptr<Vehicle> v, double startTime, double duration) {
     double endTime = startTime + duration;
-    if (endTime > SIM_DURATION) return;
 
-    double distance = v->getDistancePerFlight();
+    double distance = v->type.cruiseSpeed * duration;
     Stats &s = stats[v->type.company];
     s.totalFlightTime += duration;
     s.totalDistance += distance;
     s.totalFlights++;
     s.passengerMiles += v->type.passengerCount * distance;
 
-    if (dist01(rng) < v->type.faultProbPerHour * duration)
+    double u = scenario.commonRandomNumbers
+                   ? counterUniform(scenario.seed, uint64_t(v->id) * NUM_STREAMS + FAULT_STREAM, v->flights)
+                   : dist01(rng);
+    if (scenario.antitheticFaults) u = 1 - u;
+    v->flights++;
+    double p = std::min(v->type.faultProbPerHour * duration, 1.0);
+    double q = p;
+    auto tilt = scenario.faultTilt.find(v->type.company);
+    if (tilt != scenario.faultTilt.end()) q = p * tilt->second / (1 - p + p * tilt->second);
+    s.expectedFaults += p;
+    bool fault = u < q;
+    if (fault)
         s.totalFaults++;
+    if (q != p) logLikelihood += fault ? std::log(p / q) : std::log((1 - p) / (1 - q));
+    if (scenario.trackGradients) gradientFlightEnd(*v, duration, fault);
+    if (stateOfCharge()) v->charge = 0.0;
 
-    chargingQueue.push(v);
+    chargingQueue.push_back(v);
     tryCharging(endTime);
 }
 
 void Simulation::tryCharging(double currentTime) {
-    for (int i = 0; i < NUM_CHARGERS; ++i) {
+    std::vector<size_t> started;
+    for (size_t i = 0; i < activeChargers.size(); ++i) {
         if (!activeChargers[i] && !chargingQueue.empty()) {
-            auto v = chargingQueue.front(); chargingQueue.pop();
+            auto v = chargingQueue.front(); chargingQueue.pop_front();
             double chargeEnd = currentTime + v->type.timeToCharge;
-            if (chargeEnd > SIM_DURATION) continue;
 
             activeChargers[i] = v;
-            eventQueue.push({chargeEnd, [this, v, i]() {
-                finishCharging(v, i);
-            }});
+            if (checkpointInterval > 0)
+                trajectory.push_back({dispatched, currentTime, CHARGE_START, v->typeIndex, int(i)});
+            if (scenario.sitePower > 0) {
+                chargerPower[i] = {v->type.batteryCapacity, 0.0, currentTime, currentTime};
+                continue;
+            }
+            if (stateOfCharge()) {
+                chargerPower[i].start = currentTime;
+                started.push_back(i);
+                continue;
+            }
+            Event e{chargeEnd, CHARGE_END};
+            e.vehicleId = v->id;
+            e.chargerId = i;
+            pushEvent(e);
+            if (scenario.trackGradients) gradientChargeStart(*v, currentTime);
         }
     }
+    allocatePower(currentTime);
+    bool waiting = !chargingQueue.empty();
+    if (stateOfCharge()) scheduleCharges(currentTime, std::move(started), waiting != queueWaiting);
+    if (checkpointInterval > 0 && waiting && !queueWaiting)
+        trajectory.push_back({dispatched, currentTime, QUEUE_WAIT, chargingQueue.front()->typeIndex, -1});
+    queueWaiting = waiting;
+}
+
+// Shares sitePower between the occupied chargers. Sorted by demand, each
+// charger in turn takes the smaller of its demand and an equal split of
+// what is left, which is the water-filling level; in priority order it
+// takes its demand while power lasts.
+void Simulation::allocatePower(double currentTime) {
+    if (scenario.sitePower <= 0) return;
+    std::vector<size_t> active;
+    for (size_t i = 0; i < activeChargers.size(); ++i)
+        if (activeChargers[i]) active.push_back(i);
+    auto demand = [this](size_t i) { return activeChargers[i]->type.batteryCapacity / activeChargers[i]->type.timeToCharge; };
+    if (scenario.powerAllocation == WATER_FILLING)
+        std::sort(active.begin(), active.end(), [&](size_t a, size_t b) { return demand(a) < demand(b); });
+    else
+        std::sort(active.begin(), active.end(), [this](size_t a, size_t b) {
+            return chargerPower[a].start != chargerPower[b].start ? chargerPower[a].start < chargerPower[b].start : a < b;
+        });
+
+    double left = scenario.sitePower;
+    for (size_t k = 0; k < active.size(); ++k) {
+        size_t i = active[k];
+        double share = scenario.powerAllocation == WATER_FILLING ? left / (active.size() - k) : left;
+        double rate = std::min(demand(i), share);
+        left = std::max(left - rate, 0.0);
+
+        ChargerPower& p = chargerPower[i];
+        if (rate == p.rate) continue;
+        p.remaining = std::max(p.remaining - p.rate * (currentTime - p.since), 0.0);
+        p.since = currentTime;
+        p.rate = rate;
+        cancelChargerEvents(i);
+        if (rate <= 0) continue;
+        Event e{currentTime + p.remaining / rate, CHARGE_END};
+        e.vehicleId = activeChargers[i]->id;
+        e.chargerId = i;
+        e.startTime = p.start;
+        pushEvent(e);
+    }
 }
 
 void Simulation::finishCharging(std::shared_ptr<Vehicle> v, int chargerIndex) {
-    double now = eventQueue.top().time;
     Stats &s = stats[v->type.company];
-    s.totalChargeTime += v->type.timeToCharge;
+    s.totalChargeTime += scenario.sitePower > 0 || stateOfCharge() ? now - chargerPower[chargerIndex].start
+                                                                   : v->type.timeToCharge;
+    if (stateOfCharge()) v->charge = curves.chargeAfter(v->typeIndex, now - chargerPower[chargerIndex].start);
     s.totalCharges++;
+    if (scenario.trackGradients) gradientChargeEnd(*v);
     activeChargers[chargerIndex] = nullptr;
+    chargerPower[chargerIndex] = ChargerPower();
     scheduleFlight(v, now);
     tryCharging(now);
 }
 
-void Simulation::run() {
-    while (!eventQueue.empty() && eventQueue.top().time <= SIM_DURATION) {
-        auto e = eventQueue.top(); eventQueue.pop();
-        e.action();
+void Simulation::addCharger() {
+    activeChargers.push_back(nullptr);
+    chargerPower.emplace_back();
+    chargerGeneration.push_back(0);
+    chargerPending.push_back(0);
+    tryCharging(now);
+}
+
+// Grounded vehicles keep their accumulated stats but never fly or charge
+// again; any charger they held is handed to the next vehicle in line.
+void Simulation::groundType(Company company) {
+    for (const auto& v : vehicles) {
+        if (v->type.company != company) continue;
+        cancelVehicleEvents(v->id);
+        if (scenario.trackGradients) vehicleGradients[v->id].phase = GROUNDED;
+        for (size_t i = 0; i < activeChargers.size(); ++i) {
+            if (activeChargers[i] != v) continue;
+            activeChargers[i] = nullptr;
+            chargerPower[i] = ChargerPower();
+        }
+    }
+    chargingQueue.erase(std::remove_if(chargingQueue.begin(), chargingQueue.end(),
+                                       [company](const std::shared_ptr<Vehicle>& v) {
+                                           return v->type.company == company;
+                                       }),
+                        chargingQueue.end());
+    tryCharging(now);
+}
+
+void Simulation::pushEvent(Event e) {
+    if (e.vehicleId >= 0) {
+        e.vehicleGen = vehicleGeneration[e.vehicleId];
+        vehiclePending[e.vehicleId]++;
+    }
+    if (e.chargerId >= 0) {
+        e.chargerGen = chargerGeneration[e.chargerId];
+        chargerPending[e.chargerId]++;
     }
+    eventQueue.push_back(e);
+    std::push_heap(eventQueue.begin(), eventQueue.end(), std::greater<Event>());
+}
+
+bool Simulation::isStale(const Event& e) const {
+    return (e.vehicleId >= 0 && e.vehicleGen != vehicleGeneration[e.vehicleId]) ||
+           (e.chargerId >= 0 && e.chargerGen != chargerGeneration[e.chargerId]);
+}
+
+// Drops the event from the pending counts of whichever owner still considers
+// it live; owners that cancelled it already zeroed their count.
+void Simulation::releaseEvent(const Event& e) {
+    if (e.vehicleId >= 0 && e.vehicleGen == vehicleGeneration[e.vehicleId])
+        vehiclePending[e.vehicleId]--;
+    if (e.chargerId >= 0 && e.chargerGen == chargerGeneration[e.chargerId])
+        chargerPending[e.chargerId]--;
+}
+
+void Simulation::cancelVehicleEvents(int vehicleId) {
+    vehicleGeneration[vehicleId]++;
+    staleEvents += vehiclePending[vehicleId];
+    vehiclePending[vehicleId] = 0;
+    maybeCompact();
+}
+
+void Simulation::cancelChargerEvents(int chargerIndex) {
+    chargerGeneration[chargerIndex]++;
+    staleEvents += chargerPending[chargerIndex];
+    chargerPending[chargerIndex] = 0;
+    maybeCompact();
+}
+
+// staleEvents is an upper bound (an event cancelled through both its vehicle
+// and its charger is counted twice), so compaction may fire a little early.
+void Simulation::maybeCompact() {
+    if (staleEvents >= COMPACT_MIN_STALE && staleEvents * 2 >= eventQueue.size())
+        compactQueue();
+}
+
+void Simulation::compactQueue() {
+    auto live = std::remove_if(eventQueue.begin(), eventQueue.end(), [this](const Event& e) {
+        if (!isStale(e)) return false;
+        releaseEvent(e);
+        return true;
+    });
+    eventQueue.erase(live, eventQueue.end());
+    std::make_heap(eventQueue.begin(), eventQueue.end(), std::greater<Event>());
+    staleEvents = 0;
+}
+
+void Simulation::run() {
+    runUntil(scenario.duration);
     printStats();
 }
 
+// Fresh randomness from here on, e.g. for the clones of a splitting run.
+void Simulation::reseed(unsigned seed) {
+    scenario.seed = seed;
+    rng.seed(seed);
+}
+
+void Simulation::advance(double dt) {
+    runUntil(now + dt);
+}
+
+// Events past the horizon stay queued, so a later call picks up exactly where
+// this one stopped.
+void Simulation::runUntil(double horizon) {
+    while (!eventQueue.empty() && eventQueue.front().time <= horizon) {
+        if (checkpointInterval > 0 && eventQueue.front().time >= nextCheckpoint)
+            takeTrajectoryCheckpoint();
+        std::pop_heap(eventQueue.begin(), eventQueue.end(), std::greater<Event>());
+        Event e = eventQueue.back();
+        eventQueue.pop_back();
+        bool stale = isStale(e);
+        releaseEvent(e);
+        if (stale) {
+            if (staleEvents) staleEvents--;
+            continue;
+        }
+        now = e.time;
+        if (scenario.trackGradients) nowGrad = vehicleGradients[e.vehicleId].endGrad;
+        dispatch(e);
+        dispatched++;
+    }
+    now = std::max(now, horizon);
+    nowGrad = Gradient{};
+}
+
+void Simulation::dispatch(const Event& e) {
+    switch (e.kind) {
+    case FLIGHT_END:
+        processFlightEnd(vehicles[e.vehicleId], e.startTime, e.duration);
+        break;
+    case CHARGE_END:
+        finishCharging(vehicles[e.vehicleId], e.chargerId);
+        break;
+    }
+}
+
 void Simulation::printStats() {
+    std::map<Company, int> vehicleCount;
+    for (const auto& v : vehicles) {
+        vehicleCount[v->type.company]++;
+    }
+    ::printStats(stats, vehicleCount);
+}
+
+void printStats(const std::map<Company, Stats>& stats, const std::map<Company, int>& vehicleCount) {
     std::cout << std::fixed << std::setprecision(2);
     for (auto& [comp, stat] : stats) {
         std::cout << "\nStats for " << companyNames[comp] << ":\n";
@@ -115,12 +403,6 @@ void Simulation::printStats() {
         std::cout << "  Total Passenger Miles: " << stat.passengerMiles << "\n";
     }
 
-    // Additional Vehicle Type Count Summary
-    std::map<Company, int> vehicleCount;
-    for (const auto& v : vehicles) {
-        vehicleCount[v->type.company]++;
-    }
-
     std::cout << "\nVehicle Distribution:\n";
     for (const auto& [comp, count] : vehicleCount) {
         std::cout << "  " << companyNames[comp] << ": " << count << " vehicle(s)\n";
@@ -1,22 +1,29 @@
-
 #ifndef EVTOL_SIMULATION_H
 #define EVTOL_SIMULATION_H
 
 #include <iostream>
 #include <vector>
-#include <queue>
+#include <deque>
 #include <map>
 #include <random>
 #include <functional>
 #include <string>
 #include <memory>
 #include <iomanip>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cmath>
 
 constexpr double SIM_DURATION = 3.0;
 constexpr int NUM_VEHICLES = 20;
 constexpr int NUM_CHARGERS = 3;
+constexpr size_t COMPACT_MIN_STALE = 64;
+// Bump whenever a change alters the results of a given scenario and seed;
+// cached results of other versions are then ignored.
+constexpr int ENGINE_VERSION = 1;
 
-enum Company { ALPHA, BRAVO, CHARLIE, DELTA, ECHO };
+enum Company { ALPHA, BRAVO, CHARLIE, DELTA, ECHO, NUM_COMPANIES };
 extern const std::vector<std::string> companyNames;
 
 struct VehicleType {
@@ -29,35 +36,226 @@ struct VehicleType {
     double faultProbPerHour;
 };
 
+std::vector<VehicleType> defaultVehicleTypes();
+
+// Counter-based uniform draw in [0, 1): the value depends only on (seed,
+// stream, counter), so it is reproducible regardless of event order, thread
+// or partitioning. Per-vehicle streams are vehicleId * NUM_STREAMS + kind.
+enum RandomStream { TYPE_STREAM, FAULT_STREAM, ROUTE_STREAM, NUM_STREAMS };
+double counterUniform(uint64_t seed, uint64_t stream, uint64_t counter);
+
+// How a power-capped site shares its power between the charging vehicles:
+// WATER_FILLING gives every vehicle the same rate, capped at what its own
+// charger would draw, and passes what a capped vehicle leaves to the rest;
+// PRIORITY serves vehicles at full rate in the order their charges began.
+enum PowerAllocation { WATER_FILLING, PRIORITY };
+
+// Everything a run depends on besides its random draws.
+struct Scenario {
+    std::vector<VehicleType> vehicleTypes = defaultVehicleTypes();
+    int numVehicles = NUM_VEHICLES;
+    // When set, the number of vehicles of each vehicle type; replaces the
+    // random draw of numVehicles types.
+    std::vector<int> fleetMix;
+    int numChargers = NUM_CHARGERS;
+    double duration = SIM_DURATION;
+    unsigned seed = std::random_device()();
+    // Vehicle i's type and the fault draw of its k-th flight come from its
+    // own counter-based streams, so two scenarios with the same seed see the
+    // same vehicles and the same fault luck however their event orders differ.
+    bool commonRandomNumbers = false;
+    bool antitheticFaults = false;  // draw each fault with 1 - u in place of u
+    // Multiplies the odds of a company's per-flight fault for importance
+    // sampling; the run's likelihoodRatio() undoes the change of measure.
+    std::map<Company, double> faultTilt;
+    bool trackGradients = false;  // carry the derivatives read by gradients()
+    // Caps the power all chargers draw together (battery capacity units per
+    // hour); 0 leaves every charger at its own batteryCapacity / timeToCharge.
+    double sitePower = 0.0;
+    PowerAllocation powerAllocation = WATER_FILLING;
+    // Below 1, charges along a CC-CV curve (see ChargeCurves) instead of at a
+    // constant rate.
+    double chargeKnee = 1.0;
+    double chargeCutoff = 0.05;  // CC-CV current at full, over the nominal rate
+    // Below 1, a vehicle charging while others wait leaves once it reaches
+    // this state of charge, and its next flight lasts that fraction of a full
+    // one; once the queue empties, vehicles still charging go back to
+    // charging to full.
+    double departureCharge = 1.0;
+};
+
+// Aggregate fleet state per vehicle type (index into vehicleTypes): how
+// many vehicles are flying, waiting for a charger and charging.
+struct FleetState {
+    std::vector<double> flying, queued, charging;
+};
+
 struct Stats {
     double totalFlightTime = 0;
     double totalDistance = 0;
     double totalChargeTime = 0;
     double passengerMiles = 0;
-    int totalFlights = 0;
-    int totalCharges = 0;
-    int totalFaults = 0;
+    long long totalFlights = 0;
+    long long totalCharges = 0;
+    long long totalFaults = 0;
+    double expectedFaults = 0;  // sum of the flights' fault probabilities, min(faultProbPerHour * duration, 1)
 };
 
+Stats& operator+=(Stats& a, const Stats& b);
+Stats operator-(const Stats& a, const Stats& b);
+void printStats(const std::map<Company, Stats>& stats, const std::map<Company, int>& vehicleCount);
+
 class Vehicle {
 public:
     VehicleType type;
+    int id = -1;
+    int typeIndex = 0;  // into the simulation's vehicleTypes
     double nextAvailableTime = 0.0;
-    Vehicle(VehicleType t);
+    long long flights = 0;
+    double charge = 1.0;
+    Vehicle(VehicleType t, int id = -1, int typeIndex = 0);
     double getFlightDuration();
     double getDistancePerFlight();
 };
 
+enum EventKind { FLIGHT_END, CHARGE_END };
+
+// Events carry the generation of the vehicle/charger they belong to; bumping
+// a generation cancels every pending event stamped with the old value.
+// Events are plain data so the queue can be checkpointed byte for byte.
 struct Event {
     double time;
-    std::function<void()> action;
+    EventKind kind;
+    int vehicleId = -1;
+    int chargerId = -1;
+    unsigned vehicleGen = 0;
+    unsigned chargerGen = 0;
+    double startTime = 0.0;
+    double duration = 0.0;
     bool operator>(const Event& other) const;
 };
 
+// A charger's share of a capped site: the energy still to deliver as of
+// `since`, the rate it is delivered at and when the charge began. Only
+// chargers whose rate changes get their CHARGE_END rescheduled. `target` is
+// the state of charge the vehicle leaves at under the state-of-charge model.
+struct ChargerPower {
+    double remaining = 0.0;
+    double rate = 0.0;
+    double since = 0.0;
+    double start = 0.0;
+    double target = 1.0;
+};
+
+// Charging from empty along a CC-CV profile, per vehicle type (index into
+// the types given): constant current at the nominal rate (empty to full in
+// timeToCharge) up to `knee`, then a current tapering linearly with the
+// state of charge to `cutoff` times the nominal rate at full.
+// Time-to-charge and charge-after-time are tabulated on uniform grids for
+// every type up front; lookups interpolate linearly, and the batched forms
+// look up many chargers in one call over one flat table.
+class ChargeCurves {
+public:
+    static constexpr int POINTS = 129;
+
+    ChargeCurves() = default;
+    ChargeCurves(const std::vector<VehicleType>& types, double knee, double cutoff);
+    double timeTo(int type, double charge) const;
+    double chargeAfter(int type, double hours) const;
+    void timesTo(const int* type, const double* charge, double* hours, size_t n) const;
+    void chargesAfter(const int* type, const double* hours, double* charge, size_t n) const;
+
+private:
+    std::vector<double> time;    // [type][k]: hours to reach charge k / (POINTS - 1)
+    std::vector<double> charge;  // [type][k]: charge after k * step[type] hours
+    std::vector<double> step;
+};
+
+enum TrajectoryKind { CHARGE_START, QUEUE_WAIT };
+
+// Points where a run would react to a change in charger count or charge
+// time: every charge start, and every time the charging queue starts to
+// back up. `event` is the index of the dispatched event that produced it.
+struct TrajectoryEntry {
+    uint64_t event;
+    double time;
+    TrajectoryKind kind;
+    int type;  // index into vehicleTypes
+    int charger;
+};
+
+struct TrajectoryCheckpoint {
+    uint64_t event;
+    double time;
+    std::vector<char> state;
+};
+
+class Simulation;
+
+// Continuous parameters differentiated by infinitesimal perturbation
+// analysis, per company; a Gradient holds d/d(company, parameter) at
+// gradientIndex(company, parameter).
+enum GradientParameter { D_TIME_TO_CHARGE, D_CRUISE_SPEED, D_BATTERY_CAPACITY, NUM_GRADIENT_PARAMETERS };
+using Gradient = std::array<double, NUM_COMPANIES * NUM_GRADIENT_PARAMETERS>;
+inline size_t gradientIndex(Company company, GradientParameter parameter) {
+    return company * NUM_GRADIENT_PARAMETERS + parameter;
+}
+
+// Stats counts complete flights and charges only, so its totals jump when a
+// parameter change moves an event across the horizon and have no useful
+// pathwise derivative. `accrued` also counts the elapsed part of flights and
+// charges in progress; it is continuous in the parameters, so its IPA
+// derivatives are unbiased. faultScore is d log P(run) / d faultProbPerHour;
+// faultDerivative, totalFaults * faultScore, is the likelihood-ratio
+// estimate of d E[totalFaults] / d faultProbPerHour.
+struct CompanyGradient {
+    Stats accrued;
+    Gradient flightTime{}, distance{}, chargeTime{}, passengerMiles{}, expectedFaults{};
+    double faultScore = 0;
+    double faultDerivative = 0;
+};
+
+// A what-if branch: applied to a forked copy of a running simulation.
+struct Branch {
+    std::string name;
+    std::function<void(Simulation&)> modify;
+};
+
+struct BranchResult {
+    std::string name;
+    std::map<Company, Stats> stats;
+    std::map<Company, Stats> delta;
+};
+
 class Simulation {
 public:
-    Simulation();
+    explicit Simulation(const Scenario& scenario = Scenario());
+    explicit Simulation(unsigned seed);
     void run();
+    void runUntil(double horizon);
+    void advance(double dt);
+    double currentTime() const { return now; }
+    const std::map<Company, Stats>& getStats() const { return stats; }
+    double likelihoodRatio() const { return std::exp(logLikelihood); }
+    std::map<Company, CompanyGradient> gradients() const;
+    void reseed(unsigned seed);
+    void printStats();
+    void addCharger();
+    void groundType(Company company);
+    std::vector<BranchResult> branch(const std::vector<Branch>& branches, double horizon) const;
+    void recordTrajectory(double checkpointInterval);
+    const std::vector<TrajectoryEntry>& getTrajectory() const { return trajectory; }
+    Simulation resimulate(const Scenario& modified) const;
+    FleetState fleetState() const;
+    void liftFleetState(const FleetState& state, double startTime);
+    void cancelVehicleEvents(int vehicleId);
+    void cancelChargerEvents(int chargerIndex);
+    size_t pendingEvents() const { return eventQueue.size() - std::min(staleEvents, eventQueue.size()); }
+
+    std::vector<char> snapshot() const;
+    void restore(const char* data, size_t size);
+    void saveCheckpoint(const std::string& path) const;
+    void loadCheckpoint(const std::string& path);
 
 private:
     void loadVehicleTypes();
@@ -66,14 +264,59 @@ private:
     void processFlightEnd(std::shared_ptr<Vehicle> v, double startTime, double duration);
     void tryCharging(double currentTime);
     void finishCharging(std::shared_ptr<Vehicle> v, int chargerIndex);
-    void printStats();
+    void allocatePower(double currentTime);
+    bool stateOfCharge() const { return scenario.chargeKnee < 1 || scenario.departureCharge < 1; }
+    void scheduleCharges(double currentTime, std::vector<size_t> chargers, bool queueChanged);
+    void dispatch(const Event& e);
+    void takeTrajectoryCheckpoint();
+    void gradientFlightStart(const Vehicle& v, double startTime);
+    void gradientFlightEnd(const Vehicle& v, double duration, bool fault);
+    void gradientChargeStart(const Vehicle& v, double startTime);
+    void gradientChargeEnd(const Vehicle& v);
+    void resizeChargers(size_t count);
+    size_t snapshotSize() const;
+    void writeSnapshot(char* out) const;
+    void pushEvent(Event e);
+    bool isStale(const Event& e) const;
+    void releaseEvent(const Event& e);
+    void maybeCompact();
+    void compactQueue();
 
-    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> eventQueue;
-    std::queue<std::shared_ptr<Vehicle>> chargingQueue;
+    // Binary min-heap ordered by std::greater<Event>; kept as a vector so it
+    // can be compacted in place.
+    std::vector<Event> eventQueue;
+    Scenario scenario;
+    double now = 0.0;
+    uint64_t dispatched = 0;
+    double logLikelihood = 0.0;
+    size_t staleEvents = 0;
+    std::vector<unsigned> vehicleGeneration, chargerGeneration;
+    std::vector<int> vehiclePending, chargerPending;
+    std::deque<std::shared_ptr<Vehicle>> chargingQueue;
     std::vector<std::shared_ptr<Vehicle>> activeChargers;
+    std::vector<ChargerPower> chargerPower;
+    ChargeCurves curves;
     std::vector<VehicleType> vehicleTypes;
     std::vector<std::shared_ptr<Vehicle>> vehicles;
     std::map<Company, Stats> stats;
+    double checkpointInterval = 0.0;
+    double nextCheckpoint = 0.0;
+    bool queueWaiting = false;
+    std::vector<TrajectoryEntry> trajectory;
+    std::vector<TrajectoryCheckpoint> checkpoints;
+    // Derivatives of each vehicle's current phase start and end times, and
+    // of the current event time.
+    enum GradientPhase { FLYING, QUEUED, CHARGING, GROUNDED };
+    struct VehicleGradient {
+        GradientPhase phase = FLYING;
+        double start = 0;
+        Gradient startGrad{}, endGrad{};
+    };
+    std::vector<VehicleGradient> vehicleGradients;
+    Gradient nowGrad{};
+    std::map<Company, CompanyGradient> completedGradients;
+    std::default_random_engine rng;
+    std::uniform_real_distribution<double> dist01{0.0, 1.0};
 };
 
 #endif
@@ -1,31 +1,69 @@
-#include <iostream>
+#include "Optimizer.h"
+#include "RareEvent.h"
+#include "Sensitivity.h"
+#include "Surrogate.h"
+#include "TimeParallel.h"
+#include "TimeWarpNetwork.h"
+
+#include <cerrno>
 #include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sys/wait.h>
 
-enum Company { ALPHA, BRAVO, CHARLIE, DELTA, ECHO };
+int failures = 0;
 
-struct VehicleType {
-    Company company;
-    double cruiseSpeed;
-    double batteryCapacity;
-    double timeToCharge;
-    double energyPerMile;
-    int passengerCount;
-    double faultProbPerHour;
-};
+void report(const std::string& name, bool passed, const std::string& detail = "") {
+    if (passed) {
+        std::cout << name << " Test Passed\n";
+    } else {
+        std::cout << name << " Test Failed. " << detail << "\n";
+        failures++;
+    }
+}
 
-class Vehicle {
-public:
-    VehicleType type;
-    Vehicle(VehicleType t) : type(t) {}
-    
-    double getFlightDuration() {
-        return type.batteryCapacity / (type.cruiseSpeed * type.energyPerMile);
+bool sameStats(const std::map<Company, Stats>& a, const std::map<Company, Stats>& b) {
+    if (a.size() != b.size()) return false;
+    for (const auto& [comp, x] : a) {
+        auto it = b.find(comp);
+        if (it == b.end()) return false;
+        const Stats& y = it->second;
+        if (x.totalFlightTime != y.totalFlightTime || x.totalDistance != y.totalDistance ||
+            x.totalChargeTime != y.totalChargeTime || x.passengerMiles != y.passengerMiles ||
+            x.totalFlights != y.totalFlights || x.totalCharges != y.totalCharges ||
+            x.totalFaults != y.totalFaults || x.expectedFaults != y.expectedFaults)
+            return false;
     }
+    return true;
+}
 
-    double getDistancePerFlight() {
-        return type.cruiseSpeed * getFlightDuration();
+bool closeStats(const std::map<Company, Stats>& a, const std::map<Company, Stats>& b, double tolerance) {
+    auto close = [tolerance](double x, double y) { return std::abs(x - y) <= tolerance * std::max(1.0, std::abs(y)); };
+    if (a.size() != b.size()) return false;
+    for (const auto& [comp, x] : a) {
+        auto it = b.find(comp);
+        if (it == b.end()) return false;
+        const Stats& y = it->second;
+        if (!close(x.totalFlightTime, y.totalFlightTime) || !close(x.totalDistance, y.totalDistance) ||
+            !close(x.totalChargeTime, y.totalChargeTime) || !close(x.passengerMiles, y.passengerMiles) ||
+            x.totalFlights != y.totalFlights || x.totalCharges != y.totalCharges || x.totalFaults != y.totalFaults)
+            return false;
     }
-};
+    return true;
+}
+
+double totalMiles(const std::map<Company, Stats>& stats) {
+    double total = 0;
+    for (const auto& [comp, s] : stats) total += s.passengerMiles;
+    return total;
+}
+
+Scenario seeded(unsigned seed) {
+    Scenario s;
+    s.seed = seed;
+    return s;
+}
 
 void testFlightDuration() {
     VehicleType bravo = {BRAVO, 100, 100, 0.2, 1.5, 5, 0.10};
@@ -37,6 +75,7 @@ void testFlightDuration() {
         std::cout << "Flight Duration Test Passed\n";
     } else {
         std::cout << "Flight Duration Test Failed. Expected " << expected << ", got " << actual << "\n";
+        failures++;
     }
 }
 
@@ -50,11 +89,702 @@ void testDistancePerFlight() {
         std::cout << "Distance Per Flight Test Passed\n";
     } else {
         std::cout << "Distance Per Flight Test Failed. Expected " << expected << ", got " << actual << "\n";
+        failures++;
+    }
+}
+
+// Cancelled events stay queued until compaction but are never dispatched.
+void testLazyCancellation() {
+    Scenario s = seeded(7);
+    s.numVehicles = 200;
+    Simulation sim(s);
+    size_t fullSize = sim.snapshot().size();
+    for (int i = 0; i < 50; ++i) sim.cancelVehicleEvents(i);
+    bool lazy = sim.pendingEvents() == 150 && sim.snapshot().size() == fullSize;
+    for (int i = 50; i < 200; ++i) sim.cancelVehicleEvents(i);
+    bool compacted = sim.pendingEvents() == 0 && sim.snapshot().size() < fullSize;
+    sim.runUntil(s.duration);
+    report("Lazy Cancellation", lazy && compacted && sim.getStats().empty(),
+           "pending " + std::to_string(sim.pendingEvents()) + ", " + std::to_string(sim.getStats().size()) +
+               " companies flew");
+}
+
+void testGroundType() {
+    Simulation sim(seeded(11));
+    sim.runUntil(1.0);
+    sim.groundType(ALPHA);
+    auto grounded = sim.getStats().count(ALPHA) ? sim.getStats().at(ALPHA).totalFlights : 0;
+    sim.runUntil(SIM_DURATION);
+    auto after = sim.getStats().count(ALPHA) ? sim.getStats().at(ALPHA).totalFlights : 0;
+    report("Ground Type", grounded == after, "Alpha kept flying after grounding");
+}
+
+void testCheckpointRoundTrip() {
+    const std::string path = "/tmp/evtol_test_checkpoint.bin";
+    Simulation original(seeded(21));
+    original.runUntil(1.0);
+    original.saveCheckpoint(path);
+    original.runUntil(SIM_DURATION);
+
+    Simulation restored(seeded(99));
+    restored.loadCheckpoint(path);
+    restored.runUntil(SIM_DURATION);
+    report("Checkpoint Round Trip", sameStats(original.getStats(), restored.getStats()),
+           "restored run diverged from the original");
+}
+
+// A state that cannot be checkpointed must leave an existing file alone.
+void testCheckpointRefusalKeepsFile() {
+    const std::string path = "/tmp/evtol_test_checkpoint_keep.bin";
+    Simulation plain(seeded(22));
+    plain.runUntil(0.5);
+    plain.saveCheckpoint(path);
+
+    Scenario s = seeded(22);
+    s.trackGradients = true;
+    Simulation tracked(s);
+    bool threw = false;
+    try {
+        tracked.saveCheckpoint(path);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    Simulation restored(seeded(1));
+    restored.loadCheckpoint(path);
+    report("Checkpoint Refusal Keeps File", threw && restored.currentTime() == plain.currentTime(),
+           "gradient run was saved or clobbered the existing checkpoint");
+}
+
+// A snapshot that is rejected, whether truncated or restored into a run
+// tracking gradients, leaves the receiving simulation untouched.
+void testRejectedRestoreKeepsState() {
+    Simulation source(seeded(23));
+    source.runUntil(1.0);
+    std::vector<char> state = source.snapshot();
+
+    Simulation target(seeded(24)), reference(seeded(24));
+    target.runUntil(0.5);
+    bool threw = false;
+    try {
+        target.restore(state.data(), state.size() - 1);
+    } catch (const std::runtime_error&) {
+        threw = true;
     }
+    Scenario tracked = seeded(25);
+    tracked.trackGradients = true;
+    Simulation gradients(tracked);
+    try {
+        gradients.restore(state.data(), state.size());
+        threw = false;
+    } catch (const std::runtime_error&) {
+    }
+    target.runUntil(SIM_DURATION);
+    reference.runUntil(SIM_DURATION);
+    gradients.runUntil(SIM_DURATION);
+    report("Rejected Restore Keeps State", threw && sameStats(target.getStats(), reference.getStats()),
+           "a rejected snapshot was accepted or changed the simulation");
+}
+
+// Events past the horizon stay queued, so stopping and resuming changes
+// nothing.
+void testRunUntilInSteps() {
+    Simulation whole(seeded(31)), stepped(seeded(31));
+    whole.runUntil(SIM_DURATION);
+    for (int k = 1; k <= 12; ++k) stepped.runUntil(SIM_DURATION * k / 12);
+    Simulation advanced(seeded(31));
+    while (advanced.currentTime() < SIM_DURATION - 1e-9) advanced.advance(0.1);
+    report("Run Until In Steps",
+           sameStats(whole.getStats(), stepped.getStats()) && closeStats(whole.getStats(), advanced.getStats(), 1e-12),
+           "stepped run diverged from a single runUntil");
+}
+
+void testBranchMatchesDirectRun() {
+    Simulation sim(seeded(41));
+    sim.runUntil(1.0);
+    auto results = sim.branch({{"extra charger", [](Simulation& s) { s.addCharger(); }}}, SIM_DURATION);
+
+    Simulation direct(seeded(41));
+    direct.runUntil(1.0);
+    direct.addCharger();
+    direct.runUntil(SIM_DURATION);
+    report("Branch Matches Direct Run", results.size() == 1 && sameStats(results[0].stats, direct.getStats()),
+           "forked branch diverged from the same change made in place");
+}
+
+// A failing branch is reported, and every child is reaped either way.
+void testFailedBranchReapsChildren() {
+    Simulation sim(seeded(42));
+    bool threw = false;
+    try {
+        sim.branch({{"ok", nullptr}, {"broken", [](Simulation&) { throw std::runtime_error("broken"); }}}, 1.0);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    bool reaped = ::waitpid(-1, nullptr, WNOHANG) < 0 && errno == ECHILD;
+    report("Failed Branch Reaps Children", threw && reaped, "failure not reported or children left behind");
+}
+
+// Resuming from a recorded trajectory gives what a fresh run of the
+// modified scenario gives, including when the change is one that cannot
+// share a prefix and when recording only started part way through.
+void testResimulateMatchesFreshRun() {
+    Scenario base = seeded(51);
+    Simulation recorded(base), late(base);
+    recorded.recordTrajectory(0.1);
+    recorded.runUntil(base.duration);
+    late.runUntil(1.0);
+    late.recordTrajectory(0.1);
+    late.runUntil(base.duration);
+
+    bool matches = true;
+    std::vector<Scenario> changes;
+    for (int chargers : {1, 2, 4}) {
+        changes.push_back(base);
+        changes.back().numChargers = chargers;
+    }
+    changes.push_back(base);
+    changes.back().vehicleTypes[BRAVO].timeToCharge = 0.4;
+    changes.push_back(base);
+    changes.back().commonRandomNumbers = true;
+    changes.push_back(base);
+    changes.back().faultTilt[ECHO] = 3.0;
+    for (const Scenario& modified : changes) {
+        Simulation fresh(modified);
+        fresh.runUntil(modified.duration);
+        for (const Simulation* source : {&recorded, &late}) {
+            Simulation resumed = source->resimulate(modified);
+            resumed.runUntil(modified.duration);
+            matches = matches && sameStats(resumed.getStats(), fresh.getStats()) &&
+                      resumed.likelihoodRatio() == fresh.likelihoodRatio();
+        }
+    }
+    report("Resimulate Matches Fresh Run", matches, "a resumed scenario diverged from its fresh run");
+}
+
+NetworkScenario smallNetwork(unsigned seed) {
+    NetworkScenario n;
+    n.numVertiports = 8;
+    n.vehiclesPerVertiport = 10;
+    n.chargersPerVertiport = 2;
+    n.seed = seed;
+    return n;
+}
+
+// The conservative engine gives the same results for any thread count.
+void testConservativeThreadCounts() {
+    NetworkScenario n = smallNetwork(61);
+    VertiportNetwork serial(n), parallel(n);
+    serial.run(1);
+    parallel.run(4);
+    report("Conservative Thread Counts", sameStats(serial.getStats(), parallel.getStats()) &&
+                                             !serial.getStats().empty(),
+           "thread count changed the network results");
+}
+
+// Committed Time Warp results match the conservative engine's, with
+// positioned sites where legs and lookahead vary.
+void testTimeWarpMatchesConservative() {
+    bool matches = true;
+    for (bool positioned : {false, true}) {
+        NetworkScenario n = smallNetwork(62);
+        if (positioned) n.sitePositions = randomSites(n.numVertiports, 12.0, 63);
+        VertiportNetwork conservative(n);
+        conservative.run(4);
+        TimeWarpNetwork optimistic(n);
+        optimistic.run(4, 32);
+        matches = matches && closeStats(optimistic.getStats(), conservative.getStats(), 1e-9);
+    }
+    report("Time Warp Matches Conservative", matches, "optimistic and conservative engines disagree");
+}
+
+// Parareal approximates the sequential run of the same fleet: windows
+// after the first restart from a lifted aggregate state.
+void testPararealNearSequential() {
+    Scenario s = seeded(71);
+    s.fleetMix = {4, 4, 4, 4, 4};
+    s.duration = 12.0;
+    PararealOptions options;
+    options.windows = 4;
+    options.threads = 4;
+    PararealResult parallel = runParareal(s, options);
+    Simulation sequential(s);
+    sequential.runUntil(s.duration);
+    double a = totalMiles(parallel.stats), b = totalMiles(sequential.getStats());
+    report("Parareal Near Sequential", parallel.iterations <= options.windows && std::abs(a - b) < 0.05 * b,
+           "parareal " + std::to_string(a) + " against sequential " + std::to_string(b));
+}
+
+// The fluid model scales exactly with the fleet and charger counts and
+// stays close to the detailed simulation of a large fleet.
+void testFluidModelScales() {
+    auto scaled = [](int k) {
+        Scenario s = seeded(81);
+        s.fleetMix = {4 * k, 4 * k, 4 * k, 4 * k, 4 * k};
+        s.numChargers = 3 * k;
+        s.duration = 12.0;
+        return s;
+    };
+    double one = totalMiles(FluidModel(scaled(1)).run(12.0));
+    double hundred = totalMiles(FluidModel(scaled(100)).run(12.0));
+    Simulation sim(scaled(100));
+    sim.runUntil(12.0);
+    double simulated = totalMiles(sim.getStats());
+    report("Fluid Model Scales",
+           std::abs(hundred - 100 * one) < 1e-9 * hundred && std::abs(hundred - simulated) < 0.1 * simulated,
+           "fluid " + std::to_string(hundred) + " against simulated " + std::to_string(simulated));
+}
+
+// A type that never lands or never finishes charging has no fluid rate, so
+// the model refuses it rather than stepping by zero or infinity.
+void testFluidModelRejectsDegenerateTypes() {
+    bool rejected = true;
+    for (int k = 0; k < 3; ++k) {
+        Scenario s = seeded(85);
+        VehicleType& t = s.vehicleTypes[0];
+        (k == 0 ? t.timeToCharge : k == 1 ? t.cruiseSpeed : t.batteryCapacity) = 0;
+        try {
+            FluidModel model(s);
+            rejected = false;
+        } catch (const std::runtime_error&) {
+        }
+    }
+    report("Fluid Model Rejects Degenerate Types", rejected, "a type with a zero phase was accepted");
+}
+
+// More chargers never lower throughput or raise waiting, and with a
+// charger per vehicle waiting is a small fraction of the charge.
+void testChargerCurveMonotone() {
+    Scenario s = seeded(91);
+    auto curve = chargerCurve(s, 1, s.numVehicles);
+    bool monotone = true;
+    for (size_t k = 1; k < curve.size(); ++k)
+        for (size_t i = 0; i < s.vehicleTypes.size(); ++i)
+            monotone = monotone && curve[k].throughput[i] >= curve[k - 1].throughput[i] - 1e-9 &&
+                       curve[k].waitingTime[i] <= curve[k - 1].waitingTime[i] + 1e-9;
+    double wait = 0;
+    for (size_t i = 0; i < s.vehicleTypes.size(); ++i)
+        wait = std::max(wait, curve.back().waitingTime[i] / s.vehicleTypes[i].timeToCharge);
+    report("Charger Curve Monotone", monotone && wait < 0.05, "throughput or waiting time moved the wrong way");
+}
+
+// Pilots extrapolate past a warm-up, so they see the chargers: more of
+// them score higher, and the finalists are the well-supplied points. Every
+// point counts the replications behind its samples.
+void testPilotSeesChargers() {
+    std::vector<Scenario> grid;
+    for (int chargers = 1; chargers <= 8; ++chargers) {
+        grid.push_back(seeded(101));
+        grid.back().duration = 12.0;
+        grid.back().numChargers = chargers;
+    }
+    FidelityPolicy policy;
+    policy.screenKeepFraction = 1.0;
+    policy.screen = {0.0, 1.0, 1e9};
+    auto points = multiFidelitySweep(grid, netPassengerMiles(300), policy);
+    std::map<int, double> pilotScore;
+    bool finalistsOk = true;
+    for (const auto& p : points) {
+        pilotScore[p.scenario.numChargers] = p.pilotScore;
+        if (p.fidelity == FULL && p.scenario.numChargers < 4) finalistsOk = false;
+        if (p.replications != int(p.samples.size())) finalistsOk = false;
+    }
+    report("Pilot Sees Chargers", finalistsOk && pilotScore[8] > 2 * pilotScore[1] && pilotScore[4] > pilotScore[2],
+           "pilot scores 1 charger " + std::to_string(pilotScore[1]) + ", 8 chargers " + std::to_string(pilotScore[8]));
+}
+
+// Replications continue until the interval is tight enough, and are the
+// same replications runReplications would have run.
+void testSequentialStopping() {
+    Scenario s = seeded(131);
+    PrecisionTarget target;
+    target.relativeHalfWidth = 0.05;
+    target.threads = 4;
+    SequentialResult result = runUntilPrecise(s, target);
+    double z = 1.959964;
+    bool precise = result.converged;
+    for (const auto& [comp, m] : result.moments)
+        precise = precise && m[PASSENGER_MILES].halfWidth(z) <= 0.05 * m[PASSENGER_MILES].mean * 1.0001;
+
+    double expected = 0;
+    for (const auto& stats : runReplications(s, result.replications, 4)) expected += totalMiles(stats);
+    expected /= result.replications;
+    double mean = totalMiles(result.mean());
+    report("Sequential Stopping", precise && std::abs(mean - expected) < 1e-9 * expected,
+           std::to_string(result.replications) + " replications, mean " + std::to_string(mean) + " against " +
+               std::to_string(expected));
+}
+
+// OCBA finds the best charger count and stops spending runs on a point
+// that is clearly worse.
+void testOcbaStarvesClearLosers() {
+    std::vector<Scenario> grid;
+    for (int chargers : {1, 5, 6, 8}) {
+        grid.push_back(seeded(121));
+        grid.back().numChargers = chargers;
+    }
+    OcbaPolicy policy;
+    policy.budget = 120;
+    OcbaResult result = ocbaSweep(grid, totalPassengerMiles, policy);
+    const SweepPoint& worst = result.points.back();
+    report("OCBA Starves Clear Losers",
+           result.points.front().scenario.numChargers == 8 && worst.scenario.numChargers == 1 &&
+               worst.replications == policy.initialReplications && result.probabilityCorrect >= policy.targetPcs,
+           "best " + std::to_string(result.points.front().scenario.numChargers) + " chargers, worst point ran " +
+               std::to_string(worst.replications) + " replications");
+}
+
+// A job or run that throws on a worker thread surfaces as an exception from
+// the runner instead of terminating the process.
+void testWorkerExceptionsPropagate() {
+    Scenario bad = seeded(111);
+    bad.departureCharge = 0.0;
+    auto throws = [](const std::function<void()>& f) {
+        try {
+            f();
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    auto failingJob = [](size_t i) {
+        if (i == 5) throw std::runtime_error("job 5 failed");
+    };
+    PrecisionTarget target;
+    target.threads = 4;
+    bool all = throws([&] { parallelFor(64, 4, failingJob); }) &&
+               throws([&] { runReplications(bad, 8, 4); }) &&
+               throws([&] { runUntilPrecise(bad, target); }) &&
+               throws([&] { faultTailProbability(bad, ECHO, 3, 8, 2.0, 4); });
+    report("Worker Exceptions Propagate", all, "a worker failure was swallowed");
+}
+
+// With common random numbers a scenario compared with itself differs by
+// exactly nothing, and a real change is measured more tightly than with
+// independent runs.
+void testCommonRandomNumbers() {
+    Scenario a = seeded(141), b = a;
+    b.numChargers = 4;
+    PairedComparison same = compareScenarios(a, a, 20, totalPassengerMiles, 4);
+    PairedComparison changed = compareScenarios(a, b, 20, totalPassengerMiles, 4);
+    report("Common Random Numbers",
+           same.difference.variance() == 0 && same.difference.mean == 0 && changed.varianceReduction() > 1,
+           "variance reduction " + std::to_string(changed.varianceReduction()));
+}
+
+// A flight whose fault probability reaches 1 always faults, so the control
+// variate must count it as 1 for its mean to match the fault count, and the
+// fluid and queueing models must count one fault per flight.
+void testControlVariateCapped() {
+    Scenario s = seeded(151);
+    for (auto& t : s.vehicleTypes) t.faultProbPerHour = 5.0;
+    Simulation sim(s);
+    sim.runUntil(s.duration);
+    bool exact = !sim.getStats().empty();
+    for (const auto& [comp, stat] : sim.getStats())
+        exact = exact && stat.totalFaults == stat.totalFlights && stat.expectedFaults == stat.totalFaults;
+    for (const auto& models : {FluidModel(s).run(s.duration), estimateChargers(s).expectedStats})
+        for (const auto& [comp, stat] : models)
+            exact = exact && stat.totalFaults == stat.totalFlights && stat.totalFlights > 0;
+
+    PrecisionTarget target;
+    target.fields = {FAULTS};
+    target.minReplications = target.maxReplications = 20;
+    target.reduction.controlVariate = true;
+    target.threads = 4;
+    SequentialResult result = runUntilPrecise(s, target);
+    for (const auto& [comp, m] : result.moments)
+        exact = exact && std::abs(m[FAULTS].mean - result.plain.at(comp)[FAULTS].mean) < 1e-9;
+    report("Control Variate Capped", exact, "expected faults differ from certain faults");
+}
+
+// Importance sampling and splitting agree with plain Monte Carlo on a tail
+// that plain Monte Carlo still resolves, and importance sampling gets there
+// with a tenth of the runs.
+void testRareEventEstimates() {
+    Scenario s = seeded(161);
+    s.fleetMix = {4, 4, 4, 4, 4};
+    TailEstimate plain = faultTailProbability(s, ECHO, 6, 20000, 1.0, 4);
+    TailEstimate tilted = faultTailProbability(s, ECHO, 6, 2000, 0, 4);
+    SplittingOptions options;
+    options.levels = {4, 5, 6};
+    options.trialsPerLevel = 500;
+    options.threads = 4;
+    TailEstimate split = splittingProbability(s, faultLevel(ECHO), options);
+
+    auto agrees = [&](const TailEstimate& e) {
+        double se = std::hypot(e.probability * e.relativeError, plain.probability * plain.relativeError);
+        return std::abs(e.probability - plain.probability) < 4 * se;
+    };
+    report("Rare Event Estimates", agrees(tilted) && agrees(split) && tilted.relativeError < plain.relativeError,
+           "plain " + std::to_string(plain.probability) + ", importance sampling " +
+               std::to_string(tilted.probability) + ", splitting " + std::to_string(split.probability));
+}
+
+// The first 2^k points of a scrambled Sobol sequence put exactly one point
+// in every 2^-k interval of each dimension, and sobolDesign carries that
+// balance over to the scenario parameters.
+void testSobolBalance() {
+    const int k = 6, n = 1 << k;
+    SobolSequence sobol(4, 181);
+    bool balanced = true;
+    for (int d = 0; d < sobol.dimensions(); ++d) {
+        std::vector<int> hits(n);
+        for (int i = 0; i < n; ++i) ++hits[int(sobol.point(i)[d] * n)];
+        for (int h : hits) balanced = balanced && h == 1;
+    }
+
+    ParameterRange speed{CRUISE_SPEED, ALPHA, 60, 180};
+    std::vector<int> hits(n);
+    for (const Scenario& s : sobolDesign(seeded(181), {speed}, n, 182))
+        ++hits[std::min(int(parameterPosition(s, speed) * n), n - 1)];
+    for (int h : hits) balanced = balanced && h == 1;
+    report("Sobol Balance", balanced, "an interval holds other than one point");
+}
+
+// Fault probability has no effect on the miles flown, so its indices for
+// passenger miles are zero while cruise speed carries real weight; it does
+// drive the fault count.
+void testSensitivityIndices() {
+    std::vector<ParameterRange> ranges = {{CRUISE_SPEED, ALPHA, 60, 180}, {FAULT_PROBABILITY, ALPHA, 0.1, 0.5}};
+    SensitivityIndices indices = sobolIndices(seeded(171), ranges, 256, nullptr, 4);
+    report("Sensitivity Indices",
+           indices.firstOrder[1][PASSENGER_MILES] == 0 && indices.totalOrder[1][PASSENGER_MILES] == 0 &&
+               indices.firstOrder[0][PASSENGER_MILES] > 0.2 && indices.totalOrder[1][FAULTS] > 0.05 &&
+               indices.runs == 256 * 4,
+           "cruise speed " + std::to_string(indices.firstOrder[0][PASSENGER_MILES]) + ", fault probability " +
+               std::to_string(indices.totalOrder[1][PASSENGER_MILES]));
+}
+
+// IPA derivatives of the accrued passenger miles match central finite
+// differences of the same run. Alpha's cruise speed is moved off 120 so its
+// flights do not end in a tie with another type's, where the path is not
+// differentiable.
+void testGradientsMatchFiniteDifferences() {
+    Scenario s = seeded(191);
+    s.fleetMix = {4, 4, 4, 4, 4};
+    s.commonRandomNumbers = true;
+    s.trackGradients = true;
+    for (auto& t : s.vehicleTypes)
+        if (t.company == ALPHA) t.cruiseSpeed = 125;
+    auto miles = [&](GradientParameter parameter, double h) {
+        Scenario moved = s;
+        for (auto& t : moved.vehicleTypes) {
+            if (t.company != ALPHA) continue;
+            if (parameter == D_TIME_TO_CHARGE) t.timeToCharge += h;
+            if (parameter == D_CRUISE_SPEED) t.cruiseSpeed += h;
+            if (parameter == D_BATTERY_CAPACITY) t.batteryCapacity += h;
+        }
+        Simulation sim(moved);
+        sim.runUntil(moved.duration);
+        return sim.gradients().at(ALPHA).accrued.passengerMiles;
+    };
+
+    Simulation sim(s);
+    sim.runUntil(s.duration);
+    Gradient ipa = sim.gradients().at(ALPHA).passengerMiles;
+    bool match = true;
+    std::string detail;
+    const double h = 1e-4;
+    for (GradientParameter p : {D_TIME_TO_CHARGE, D_CRUISE_SPEED, D_BATTERY_CAPACITY}) {
+        double fd = (miles(p, h) - miles(p, -h)) / (2 * h);
+        double d = ipa[gradientIndex(ALPHA, p)];
+        match = match && std::abs(d - fd) <= 1e-3 * std::max(std::abs(fd), 1.0);
+        detail += " " + std::to_string(d) + " against " + std::to_string(fd);
+    }
+    report("Gradients Match Finite Differences", match, "IPA against finite differences:" + detail);
+}
+
+// A simulated surrogate answer reports the mean fault count of its runs as
+// both the rounded fault total and the expected faults.
+void testSurrogateStatsKeepFaults() {
+    Scenario s = seeded(201);
+    Surrogate surrogate({{CHARGERS, ALPHA, 1, 8}});
+    SurrogatePolicy policy;
+    policy.threads = 4;
+    Prediction p = surrogate.query(s, policy);
+
+    std::map<Company, double> faults;
+    for (const auto& stats : runReplications(s, policy.replications, 4))
+        for (const auto& [comp, stat] : stats) faults[comp] += double(stat.totalFaults) / policy.replications;
+    bool kept = p.simulated && !faults.empty();
+    for (const auto& [comp, stat] : p.stats())
+        kept = kept && std::abs(stat.expectedFaults - faults[comp]) < 1e-9 &&
+               stat.totalFaults == std::llround(faults[comp]);
+    report("Surrogate Stats Keep Faults", kept, "expected faults differ from the simulated fault mean");
+}
+
+// The runs a paired comparison stores are read back, first from memory and then
+// by a fresh cache over the same directory, with identical results.
+void testResultCacheRoundTrip() {
+    char dir[] = "/tmp/evtol_test_cache_XXXXXX";
+    if (!mkdtemp(dir)) {
+        report("Result Cache Round Trip", false, "cannot create a cache directory");
+        return;
+    }
+    Scenario a = seeded(211), b = a;
+    b.numChargers = 5;
+    ResultCache first(dir);
+    PairedComparison fresh = compareScenarios(a, b, 6, totalPassengerMiles, 4, &first);
+    PairedComparison memory = compareScenarios(a, b, 6, totalPassengerMiles, 4, &first);
+    ResultCache second(dir);
+    PairedComparison disk = compareScenarios(a, b, 6, totalPassengerMiles, 4, &second);
+    std::filesystem::remove_all(dir);
+
+    auto same = [&](const PairedComparison& c) {
+        return c.difference.mean == fresh.difference.mean && c.difference.m2 == fresh.difference.m2;
+    };
+    report("Result Cache Round Trip",
+           first.size() == 12 && first.hits() == 12 && second.diskHits() == 12 && same(memory) && same(disk),
+           std::to_string(first.hits()) + " memory hits, " + std::to_string(second.diskHits()) + " disk hits");
+}
+
+// Per-type minimums that cannot fit in the fleet are refused up front
+// rather than leaving the search looking for a valid mix forever.
+void testOptimizerRejectsImpossibleMix() {
+    OptimizerOptions options;
+    options.fleetSize = 20;
+    options.minPerType = 5;
+    options.threads = 4;
+    bool threw = false;
+    try {
+        optimizeFleet(seeded(221), {totalPassengerMiles, fewerChargers}, options);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    report("Optimizer Rejects Impossible Mix", threw, "5 of each of 5 types was accepted for 20 vehicles");
+}
+
+// A dense positioned network, where the shortest leg is well under a
+// minute, still runs the same for any thread count with per-site lookahead.
+void testLargeNetworkThreadCounts() {
+    NetworkScenario n;
+    n.numVertiports = 300;
+    n.vehiclesPerVertiport = 2;
+    n.chargersPerVertiport = 1;
+    n.sitePositions = randomSites(n.numVertiports, 60.0, 232);
+    n.seed = 231;
+    VertiportNetwork serial(n), parallel(n);
+    serial.run(1);
+    parallel.run(4);
+    report("Large Network Thread Counts",
+           sameStats(serial.getStats(), parallel.getStats()) && !serial.getStats().empty() &&
+               serial.getLookahead() < 1.0 / 60,
+           "thread count changed the results of a 300-site network");
+}
+
+// No cap and a cap no charger set could reach leave a run as it was, under
+// either allocation; a cap that binds slows the fleet down.
+void testPowerCapDefaults() {
+    auto run = [](const Scenario& s) {
+        Simulation sim(s);
+        sim.runUntil(s.duration);
+        return sim.getStats();
+    };
+    Scenario base = seeded(241);
+    std::map<Company, Stats> uncapped = run(base);
+    bool unchanged = true;
+    for (PowerAllocation allocation : {WATER_FILLING, PRIORITY}) {
+        Scenario s = base;
+        s.powerAllocation = allocation;
+        unchanged = unchanged && sameStats(run(s), uncapped);
+        s.sitePower = 1e9;
+        unchanged = unchanged && closeStats(run(s), uncapped, 1e-9);
+    }
+    Scenario tight = base;
+    tight.sitePower = 300;
+    report("Power Cap Defaults", unchanged && totalMiles(run(tight)) < totalMiles(uncapped),
+           "a cap that never binds changed the run, or one that binds did not");
+}
+
+// departureCharge only matters while someone waits: with a charger per
+// vehicle no queue forms and the run matches the plain model, and a vehicle
+// cut short when a queue formed goes back to charging to full once it
+// drains. Two Alphas land at 1 h and a Bravo at 1.2 h on two chargers:
+// both Alphas are cut to half charge at 1.5 h, the first to finish lets the
+// Bravo in, and the other must then carry on to full at 2 h.
+void testDepartureChargeOnlyWhileWaiting() {
+    Scenario roomy = seeded(251);
+    roomy.numChargers = roomy.numVehicles;
+    Scenario early = roomy;
+    early.departureCharge = 0.5;
+    Simulation plain(roomy), partial(early);
+    plain.runUntil(roomy.duration);
+    partial.runUntil(early.duration);
+    bool unchanged = closeStats(partial.getStats(), plain.getStats(), 1e-9);
+
+    Scenario s = seeded(252);
+    s.vehicleTypes = {{ALPHA, 100, 100, 1.0, 1.0, 1, 0.0}, {BRAVO, 100, 120, 1.0, 1.0, 1, 0.0}};
+    s.fleetMix = {2, 1};
+    s.numVehicles = 3;
+    s.numChargers = 2;
+    s.departureCharge = 0.5;
+    s.duration = 2.05;
+    Simulation sim(s);
+    sim.runUntil(s.duration);
+    const Stats& alpha = sim.getStats().at(ALPHA);
+    report("Departure Charge Only While Waiting",
+           unchanged && alpha.totalCharges == 2 && std::abs(alpha.totalChargeTime - 1.5) < 1e-9,
+           "Alpha charged " + std::to_string(alpha.totalChargeTime) + " hours in " +
+               std::to_string(alpha.totalCharges) + " charges, expected 1.5 in 2");
+}
+
+// Charge curves belong to a vehicle type, not its company: a second Alpha
+// type that charges twice as slowly, with no vehicles of its own, leaves a
+// CC-CV run of the first as it was.
+void testChargeCurvesPerType() {
+    auto run = [](const std::vector<VehicleType>& types, const std::vector<int>& mix) {
+        Scenario s = seeded(261);
+        s.vehicleTypes = types;
+        s.fleetMix = mix;
+        s.numVehicles = 2;
+        s.numChargers = 1;
+        s.chargeKnee = 0.8;
+        s.duration = 6.0;
+        Simulation sim(s);
+        sim.runUntil(s.duration);
+        return sim.getStats();
+    };
+    VehicleType fast{ALPHA, 100, 100, 1.0, 1.0, 1, 0.0}, slow{ALPHA, 100, 100, 2.0, 1.0, 1, 0.0};
+    auto alone = run({fast}, {2});
+    auto shared = run({fast, slow}, {2, 0});
+    report("Charge Curves Per Type", closeStats(shared, alone, 1e-9) && alone.at(ALPHA).totalCharges > 0,
+           "a vehicle type with no vehicles changed the charge curve of another of its company");
 }
 
 int main() {
     testFlightDuration();
     testDistancePerFlight();
-    return 0;
+    testLazyCancellation();
+    testGroundType();
+    testCheckpointRoundTrip();
+    testCheckpointRefusalKeepsFile();
+    testRejectedRestoreKeepsState();
+    testRunUntilInSteps();
+    testBranchMatchesDirectRun();
+    testFailedBranchReapsChildren();
+    testResimulateMatchesFreshRun();
+    testConservativeThreadCounts();
+    testTimeWarpMatchesConservative();
+    testPararealNearSequential();
+    testFluidModelScales();
+    testFluidModelRejectsDegenerateTypes();
+    testChargerCurveMonotone();
+    testPilotSeesChargers();
+    testOcbaStarvesClearLosers();
+    testWorkerExceptionsPropagate();
+    testSequentialStopping();
+    testCommonRandomNumbers();
+    testControlVariateCapped();
+    testRareEventEstimates();
+    testSobolBalance();
+    testSensitivityIndices();
+    testGradientsMatchFiniteDifferences();
+    testSurrogateStatsKeepFaults();
+    testResultCacheRoundTrip();
+    testOptimizerRejectsImpossibleMix();
+    testLargeNetworkThreadCounts();
+    testPowerCapDefaults();
+    testDepartureChargeOnlyWhileWaiting();
+    testChargeCurvesPerType();
+    return failures ? 1 : 0;
 }